@@ -22,6 +22,19 @@
  SOFTWARE.
  ******************************************************************************/
 
+#define MPU6050_FIFO_MAX_SAMPLES 42 // 504 bytes of the 1024 bytes FIFO, a longer backlog is drained by the next calls
+
+typedef struct {
+	short ax;
+	short ay;
+	short az;
+	short temperature;
+	short gx;
+	short gy;
+	short gz;
+	struct timeval tv;
+} MPU6050_MOTION_STRUCT;
+
 bool mpu6050Init();
 float getGyroSensitivity();
 float getAccSensitivity();
@@ -29,7 +42,14 @@ float getGyroSensitivityInv();
 float getAccSensitivityInv();
 void getMotion6(float* ax, float* ay, float* az, float* gx, float* gy,
 		float* gz);
+bool getMotion7(MPU6050_MOTION_STRUCT *motion);
+void convertMotion6RawData(MPU6050_MOTION_STRUCT *motion, float* ax,
+		float* ay, float* az, float* gx, float* gy, float* gz);
+int getMotion6FifoData(MPU6050_MOTION_STRUCT *motions, int maxCount);
+void mpu6050EnableDataReadyInterrupt();
+unsigned long getMpu6050SamplePeriod();
 void getMotion6RawData(short* ax, short* ay, short* az, short* gx, short* gy,
 		short* gz);		
-bool pollingMagnetDataBySingleMeasurementMode(short* mx, short* my, short* mz);
+bool pollingMagnetDataByContinuousMode(short* mx, short* my, short* mz);
+unsigned long getMagnetSamplePeriod();
 
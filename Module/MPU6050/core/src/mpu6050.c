@@ -69,6 +69,12 @@
 #define MPU9150_RA_MAG_ZOUT_H		0x08
 #define MPU9150_RA_MAG_ST2		0x09
 #define MPU9150_RA_MAG_CNTL1		0x0A
+#define AK8963_ST1_DRDY			0x01
+#define AK8963_ST2_HOFL			0x08
+#define AK8963_MODE_CONTINUOUS_8HZ	0x02 // 14 bit output, same scale as the calibration data
+#define AK8963_MODE_CONTINUOUS_100HZ	0x06 // 14 bit output, same scale as the calibration data
+#define AK8963_MODE			AK8963_MODE_CONTINUOUS_100HZ
+#define AK8963_SAMPLE_PERIOD		((AK8963_MODE == AK8963_MODE_CONTINUOUS_100HZ) ? 10000 : 125000) // us
 #define MPU9150_RA_INT_PIN_CFG      0x37
 #define MPU6050_DEFAULT_ADDRESS     MPU6050_ADDRESS_AD0_LOW  //MPU6050_ADDRESS_AD0_LOW
 #define MPU6050_RA_XG_OFFS_TC       0x00 //[7] PWR_MODE, [6:1] XG_OFFS_TC, [0] OTP_BNK_VLD
@@ -330,8 +336,10 @@
 #define MPU6050_DETECT_DECREMENT_1      0x1
 #define MPU6050_DETECT_DECREMENT_2      0x2
 #define MPU6050_DETECT_DECREMENT_4      0x3
+#define MPU6050_USERCTRL_FIFO_EN_BIT            6
 #define MPU6050_USERCTRL_I2C_MST_EN_BIT         5
 #define MPU6050_USERCTRL_I2C_IF_DIS_BIT         4
+#define MPU6050_USERCTRL_FIFO_RESET_BIT         2
 #define MPU6050_USERCTRL_I2C_MST_RESET_BIT      1
 #define MPU6050_USERCTRL_SIG_COND_RESET_BIT     0
 #define MPU6050_PWR1_DEVICE_RESET_BIT   7
@@ -365,14 +373,34 @@
 #define MPU6050_BANKSEL_MEM_SEL_LENGTH      5
 #define MPU6050_WHO_AM_I_BIT        6
 #define MPU6050_WHO_AM_I_LENGTH     6
+#define MPU6050_FIFO_PACKET_SIZE    12 // accel x/y/z + gyro x/y/z
+#define MPU6050_FIFO_CHUNK_SIZE     252 // 21 packets, the longest block a single I2C read message can carry
+#define MPU6050_MOTION_LENGTH       14 // ACCEL_XOUT_H ~ GYRO_ZOUT_L
+#define AK8963_DATA_LENGTH          8 // ST1 ~ ST2
+#ifdef MPU6050_AUX_I2C_MAGNET
+#define MPU6050_BURST_LENGTH        (MPU6050_MOTION_LENGTH + AK8963_DATA_LENGTH) // EXT_SENS_DATA_00 follows GYRO_ZOUT_L
+#else
+#define MPU6050_BURST_LENGTH        MPU6050_MOTION_LENGTH
+#endif
 
 static unsigned char devAddr;
 static unsigned char scaleGyroRange;
 static unsigned char scaleAccRange;
-static unsigned char buffer[14];
+static unsigned char buffer[MPU6050_BURST_LENGTH];
 static short xGyroOffset;
 static short yGyroOffset;
 static short zGyroOffset;
+static unsigned long samplePeriodUs = 1000;
+#ifdef MPU6050_9AXIS
+static struct timeval lastMagnetSampleTv;
+#endif
+#if defined(MPU6050_AUX_I2C_MAGNET) && !defined(MPU6050_FIFO)
+static unsigned char auxMagnetBuffer[AK8963_DATA_LENGTH]; // AK8963 data captured by the latest getMotion7
+static bool auxMagnetIsUpdated;
+#endif
+#ifdef MPU6050_FIFO
+static unsigned char fifoBuffer[MPU6050_FIFO_MAX_SAMPLES * MPU6050_FIFO_PACKET_SIZE];
+#endif
 
 void getMotion6RawData(short* ax, short* ay, short* az, short* gx, short* gy,
 		short* gz);
@@ -408,10 +436,9 @@ void reset();
 void setXGyroOffsetTC(char offset);
 void setYGyroOffsetTC(char offset);
 void setZGyroOffsetTC(char offset);
-void enableSingleMeasurementMode16Bit();
-void enableSingleMeasurementMode14Bit();
-bool singleMeasurementModeIsEnable();
-bool magnetDataIsReady();
+void setFIFOEnabled(unsigned char enabled);
+void resetFIFO();
+unsigned short getFIFOCount();
 bool getMagnet(short* mx, short* my, short* mz);
 
 /**
@@ -492,6 +519,19 @@ bool mpu6050Init() {
 	setZGyroOffsetUser(zGyroOffset);
 	usleep(1000);
 
+#ifdef MPU6050_FIFO
+	_DEBUG(DEBUG_NORMAL, "Enabling FIFO for accel and gyro...\n");
+	setFIFOEnabled(false);
+	writeByte(devAddr, MPU6050_RA_FIFO_EN,
+			(1 << MPU6050_XG_FIFO_EN_BIT) | (1 << MPU6050_YG_FIFO_EN_BIT)
+					| (1 << MPU6050_ZG_FIFO_EN_BIT)
+					| (1 << MPU6050_ACCEL_FIFO_EN_BIT));
+	resetFIFO();
+	usleep(1000);
+	setFIFOEnabled(true);
+	setIntEnabled(1 << MPU6050_INTERRUPT_FIFO_OFLOW_BIT);
+#endif
+
 #ifdef MPU6050_9AXIS
 	_DEBUG(DEBUG_NORMAL,"setup AK8963\n");
 	_DEBUG(DEBUG_NORMAL,"Disable MPU6050 master mode\n");
@@ -515,6 +555,30 @@ bool mpu6050Init() {
 	_DEBUG(DEBUG_NORMAL,"Setup power down mode and full scale mode (16 bits) \n");
 	writeByte(MPU9150_RA_MAG_ADDRESS, 0x0A, 0x00|0x10);// power down mode|Full Scale
 	usleep(10000);
+	_DEBUG(DEBUG_NORMAL,"Setup continuous measurement mode (%d Hz)\n",
+			1000000 / AK8963_SAMPLE_PERIOD);
+	writeByte(MPU9150_RA_MAG_ADDRESS, MPU9150_RA_MAG_CNTL1, AK8963_MODE);
+	usleep(10000);
+
+#ifdef MPU6050_AUX_I2C_MAGNET
+	_DEBUG(DEBUG_NORMAL,"Disable MPU6050 bypass mode\n");
+	setI2CBypassEnabled(false);
+	usleep(10000);
+
+	_DEBUG(DEBUG_NORMAL,"Setup MPU6050 I2C master to read AK8963 into EXT_SENS_DATA\n");
+	// 400 kHz, DATA_RDY waits until the external sensor data of the same sample are loaded
+	writeByte(devAddr, MPU6050_RA_I2C_MST_CTRL,
+			(1 << MPU6050_WAIT_FOR_ES_BIT) | MPU6050_CLOCK_DIV_400);
+	setSlaveAddress(0, (1 << MPU6050_I2C_SLV_RW_BIT) | MPU9150_RA_MAG_ADDRESS);
+	writeByte(devAddr, MPU6050_RA_I2C_SLV0_REG, MPU9150_RA_MAG_ST1);
+	// ST1 ~ ST2, reading ST2 lets AK8963 update its data registers again
+	writeByte(devAddr, MPU6050_RA_I2C_SLV0_CTRL,
+			(1 << MPU6050_I2C_SLV_EN_BIT) | AK8963_DATA_LENGTH);
+	writeByte(devAddr, MPU6050_RA_I2C_MST_DELAY_CTRL,
+			1 << MPU6050_DELAYCTRL_DELAY_ES_SHADOW_BIT);
+	setI2CMasterModeEnabled(true);
+	usleep(10000);
+#endif
 #endif
 
 	return true;
@@ -736,6 +800,44 @@ void setFullScaleAccelRange(unsigned char range) {
 	scaleAccRange = range;
 }
 
+/** 
+ * Get raw 7-axis motion sensor readings (accel/temperature/gyro) by a single burst read.
+ * The 14 bytes from ACCEL_XOUT_H to GYRO_ZOUT_L are fetched in one transaction,
+ * so accel and gyro come from the same sample instant.
+ * When AK8963 is read by the I2C master of MPU6050, EXT_SENS_DATA is fetched by the same burst,
+ * and the magnet data are kept for pollingMagnetDataByContinuousMode.
+ *
+ * @param motion
+ *		 container for raw accel, temperature and gyro values and the time they were read
+ *
+ * @return 
+ * 		data is valid or not
+ *
+ */
+bool getMotion7(MPU6050_MOTION_STRUCT *motion) {
+
+	if (readBytes(devAddr, MPU6050_RA_ACCEL_XOUT_H, MPU6050_BURST_LENGTH, buffer)
+			!= MPU6050_BURST_LENGTH) {
+		return false;
+	}
+
+	gettimeofday(&motion->tv, NULL);
+	motion->ax = (((short) buffer[0]) << 8) | buffer[1];
+	motion->ay = (((short) buffer[2]) << 8) | buffer[3];
+	motion->az = (((short) buffer[4]) << 8) | buffer[5];
+	motion->temperature = (((short) buffer[6]) << 8) | buffer[7];
+	motion->gx = (((short) buffer[8]) << 8) | buffer[9];
+	motion->gy = (((short) buffer[10]) << 8) | buffer[11];
+	motion->gz = (((short) buffer[12]) << 8) | buffer[13];
+
+#if defined(MPU6050_AUX_I2C_MAGNET) && !defined(MPU6050_FIFO)
+	memcpy(auxMagnetBuffer, buffer + MPU6050_MOTION_LENGTH, AK8963_DATA_LENGTH);
+	auxMagnetIsUpdated = true;
+#endif
+
+	return true;
+}
+
 /** 
  * Get raw 6-axis motion sensor readings (accel/gyro).
  * Retrieves all currently available motion sensor values.
@@ -764,14 +866,19 @@ void setFullScaleAccelRange(unsigned char range) {
  */
 void getMotion6RawData(short* ax, short* ay, short* az, short* gx, short* gy,
 		short* gz) {
-	readBytes(devAddr, MPU6050_RA_ACCEL_XOUT_H, 6, buffer);
-	*ax = (((short) buffer[0]) << 8) | buffer[1];
-	*ay = (((short) buffer[2]) << 8) | buffer[3];
-	*az = (((short) buffer[4]) << 8) | buffer[5];
-	readBytes(devAddr, MPU6050_RA_GYRO_XOUT_H, 6, buffer);
-	*gx = (((short) buffer[0]) << 8) | buffer[1];
-	*gy = (((short) buffer[2]) << 8) | buffer[3];
-	*gz = (((short) buffer[4]) << 8) | buffer[5];
+
+	MPU6050_MOTION_STRUCT motion;
+
+	if (!getMotion7(&motion)) {
+		return;
+	}
+
+	*ax = motion.ax;
+	*ay = motion.ay;
+	*az = motion.az;
+	*gx = motion.gx;
+	*gy = motion.gy;
+	*gz = motion.gz;
 }
 
 /** 
@@ -1024,8 +1131,51 @@ void setIntEnabled(unsigned char enabled) {
 	writeByte(devAddr, MPU6050_RA_INT_ENABLE, enabled);
 }
 
+/** 
+ * Enable DATA_RDY interrupt.
+ * INT pin is active high and push-pull, it emits a 50us pulse when a sample is ready,
+ * and the interrupt status is cleared by any read operation.
+ * With FIFO, the status is only cleared by reading INT_STATUS, so FIFO_OFLOW is kept
+ * until getMotion6FifoData checks it.
+ * The bypass bit in INT_PIN_CFG is not touched.
+ *
+ * @return
+ *		void
+ *
+ */
+void mpu6050EnableDataReadyInterrupt() {
+	writeBit(devAddr, MPU6050_RA_INT_PIN_CFG, MPU6050_INTCFG_INT_LEVEL_BIT,
+			false);
+	writeBit(devAddr, MPU6050_RA_INT_PIN_CFG, MPU6050_INTCFG_INT_OPEN_BIT,
+			false);
+	writeBit(devAddr, MPU6050_RA_INT_PIN_CFG, MPU6050_INTCFG_LATCH_INT_EN_BIT,
+			false);
+#ifdef MPU6050_FIFO
+	writeBit(devAddr, MPU6050_RA_INT_PIN_CFG, MPU6050_INTCFG_INT_RD_CLEAR_BIT,
+			false);
+	setIntEnabled((1 << MPU6050_INTERRUPT_DATA_RDY_BIT)
+			| (1 << MPU6050_INTERRUPT_FIFO_OFLOW_BIT));
+#else
+	writeBit(devAddr, MPU6050_RA_INT_PIN_CFG, MPU6050_INTCFG_INT_RD_CLEAR_BIT,
+			true);
+	setIntEnabled(1 << MPU6050_INTERRUPT_DATA_RDY_BIT);
+#endif
+}
+
+/** 
+ * get the interval between two samples
+ *
+ * @return
+ *		period (us)
+ *
+ */
+unsigned long getMpu6050SamplePeriod() {
+	return samplePeriodUs;
+}
+
 void setRate(unsigned char rate) {
 	writeByte(devAddr, MPU6050_RA_SMPLRT_DIV, rate);
+	samplePeriodUs = (rate + 1) * 1000; // DLPF is enabled, so gyro output rate is 1k Hz
 }
 
 /** Set digital low-pass filter configuration.
@@ -1170,7 +1320,10 @@ void reset() {
 }
 
 /**
- * get gyro and acceleration data
+ * convert raw accel and gyro data to g and rad/sec
+ *
+ * @param motion
+ * 		raw data
  *
  * @param ax
  * 		acceleration data x
@@ -1194,96 +1347,202 @@ void reset() {
  *		void
  *
  */
-void getMotion6(float* ax, float* ay, float* az, float* gx, float* gy,
-		float* gz) {
-	short sax = 0;
-	short say = 0;
-	short saz = 0;
-	short sgx = 0;
-	short sgy = 0;
-	short sgz = 0;
-
-	getMotion6RawData(&sax, &say, &saz, &sgx, &sgy, &sgz);
-
-	*ax = (float) sax * getAccSensitivityInv();
-	*ay = (float) say * getAccSensitivityInv();
-	*az = (float) saz * getAccSensitivityInv();
-	*gx = (float) sgx * getGyroSensitivityInv() * DE_TO_RA; // rad/sec
-	*gy = (float) sgy * getGyroSensitivityInv() * DE_TO_RA; // rad/sec
-	*gz = (float) sgz * getGyroSensitivityInv() * DE_TO_RA; // rad/sec
+void convertMotion6RawData(MPU6050_MOTION_STRUCT *motion, float* ax,
+		float* ay, float* az, float* gx, float* gy, float* gz) {
+
+	*ax = (float) motion->ax * getAccSensitivityInv();
+	*ay = (float) motion->ay * getAccSensitivityInv();
+	*az = (float) motion->az * getAccSensitivityInv();
+	*gx = (float) motion->gx * getGyroSensitivityInv() * DE_TO_RA; // rad/sec
+	*gy = (float) motion->gy * getGyroSensitivityInv() * DE_TO_RA; // rad/sec
+	*gz = (float) motion->gz * getGyroSensitivityInv() * DE_TO_RA; // rad/sec
 }
 
-#ifdef MPU6050_9AXIS
 /**
- * enable single measurement mode whith 16 bit resolution
+ * get gyro and acceleration data
  *
- * @param
- * 		void
+ * @param ax
+ * 		acceleration data x
+ *
+ * @param ay
+ * 		acceleration data y
+ *
+ * @param az
+ * 		acceleration data z
+ *
+ * @param gx
+ * 		gyro data x
+ *
+ * @param gy
+ * 		gyro data y
+ *
+ * @param gz
+ * 		gyro data z
  *
  * @return 
  *		void
  *
  */
-void enableSingleMeasurementMode16Bit(){
+void getMotion6(float* ax, float* ay, float* az, float* gx, float* gy,
+		float* gz) {
 
-	writeByte(MPU9150_RA_MAG_ADDRESS, MPU9150_RA_MAG_CNTL1, 0x01|0x10);// Single Measurement mode|Full Scale
-	
+	MPU6050_MOTION_STRUCT motion;
+
+	if (!getMotion7(&motion)) {
+		return;
+	}
+
+	convertMotion6RawData(&motion, ax, ay, az, gx, gy, gz);
 }
 
-/**
- * enable single measurement mode whith 14 bit resolution
+#ifdef MPU6050_FIFO
+/** 
+ * Set FIFO enabled status.
  *
- * @param
- * 		void
+ * @param enabled 
+ *		New FIFO enabled status
  *
- * @return 
+ * @return
+ *		void	
+ * 
+ */
+void setFIFOEnabled(unsigned char enabled) {
+	writeBit(devAddr, MPU6050_RA_USER_CTRL, MPU6050_USERCTRL_FIFO_EN_BIT,
+			enabled);
+}
+
+/** 
+ * Reset the FIFO.
+ * This bit resets the FIFO buffer when set to 1 while FIFO_EN equals 0. This
+ * bit automatically clears to 0 after the reset has been triggered.
+ *
+ * @return
  *		void
  *
  */
-void enableSingleMeasurementMode14Bit(){
-
-	writeByte(MPU9150_RA_MAG_ADDRESS, MPU9150_RA_MAG_CNTL1, 0x01);// Single Measurement mode
-	
+void resetFIFO() {
+	writeBit(devAddr, MPU6050_RA_USER_CTRL, MPU6050_USERCTRL_FIFO_RESET_BIT,
+	true);
 }
 
-/**
- * check whether single measurement mode is enabled or not
- *
- * @param
- * 		void
+/** 
+ * Get current FIFO buffer size.
+ * This value indicates the number of bytes stored in the FIFO buffer.
  *
- * @return bool
- *		whether Single measurement mode is enabled or not
+ * @return
+ *		Current FIFO buffer size, 0 if failure
  *
  */
-bool singleMeasurementModeIsEnable(){
-	
-	readBytes(MPU9150_RA_MAG_ADDRESS, MPU9150_RA_MAG_CNTL1, 1, buffer);
-	return ((buffer[0] & 0x01) == 0x01);
-	
+unsigned short getFIFOCount() {
+
+	unsigned char count[2];
+
+	if (readBytes(devAddr, MPU6050_RA_FIFO_COUNTH, 2, count) != 2) {
+		return 0;
+	}
+
+	return (((unsigned short) count[0]) << 8) | count[1];
 }
 
-/**
- * check whether magnet data are ready or not
+/** 
+ * Drain accel and gyro samples from FIFO.
+ * The oldest packets in FIFO are fetched by one batched I2C transfer, the timestamp of each sample
+ * is reconstructed from the sample period backwards from the time FIFO count is read,
+ * counting the whole backlog, so the packets left for the next call keep later timestamps.
+ * FIFO is reset if FIFO_OFLOW is raised or the count isn't a whole number of packets,
+ * because the packet boundary is lost.
  *
- * @param
- * 		void
+ * @param motions
+ *		container for samples, the oldest sample is the first one
  *
- * @return bool
- *		whether data are ready or not
+ * @param maxCount
+ *		size of container
+ *
+ * @return
+ *		number of samples
  *
  */
-bool magnetDataIsReady(){
-	
-	readBytes(MPU9150_RA_MAG_ADDRESS, MPU9150_RA_MAG_ST1, 1, buffer);
-	//_DEBUG(DEBUG_NORMAL,"ST1=0x%x\n",buffer[0]);
+int getMotion6FifoData(MPU6050_MOTION_STRUCT *motions, int maxCount) {
+
+	I2C_READ_REQUEST_STRUCT requests[I2C_READ_BATCH_MAX];
+	unsigned short fifoCount = 0;
+	unsigned short length = 0;
+	unsigned short offset = 0;
+	unsigned char requestCount = 0;
+	unsigned char *packet;
+	bool isOverflow = false;
+	struct timeval tv;
+	long usec;
+	int backlog = 0;
+	int count = 0;
+	int i = 0;
+
+	isOverflow = (getIntStatus() & (1 << MPU6050_INTERRUPT_FIFO_OFLOW_BIT)) != 0;
+	fifoCount = getFIFOCount();
+	gettimeofday(&tv, NULL);
+
+	if (isOverflow || 0 != (fifoCount % MPU6050_FIFO_PACKET_SIZE)) {
+		_ERROR("(%s-%d) FIFO overflow, count=%d\n", __func__, __LINE__,
+				fifoCount);
+		setFIFOEnabled(false);
+		resetFIFO();
+		setFIFOEnabled(true);
+		return 0;
+	}
 
-	return ((buffer[0]&0x01) == 1);
-	
+	backlog = fifoCount / MPU6050_FIFO_PACKET_SIZE;
+	count = min(backlog, min(maxCount, MPU6050_FIFO_MAX_SAMPLES));
+	if (0 == count) {
+		return 0;
+	}
+
+	length = count * MPU6050_FIFO_PACKET_SIZE;
+	while (offset < length && requestCount < I2C_READ_BATCH_MAX) {
+		requests[requestCount].devAddr = devAddr;
+		requests[requestCount].regAddr = MPU6050_RA_FIFO_R_W;
+		requests[requestCount].length = min(length - offset,
+				MPU6050_FIFO_CHUNK_SIZE);
+		requests[requestCount].data = fifoBuffer + offset;
+		offset += requests[requestCount].length;
+		requestCount++;
+	}
+	count = offset / MPU6050_FIFO_PACKET_SIZE;
+
+	if (!readBytesBatch(requests, requestCount)) {
+		return 0;
+	}
+
+	for (i = 0; i < count; i++) {
+		packet = fifoBuffer + i * MPU6050_FIFO_PACKET_SIZE;
+		motions[i].ax = (((short) packet[0]) << 8) | packet[1];
+		motions[i].ay = (((short) packet[2]) << 8) | packet[3];
+		motions[i].az = (((short) packet[4]) << 8) | packet[5];
+		motions[i].temperature = 0;
+		motions[i].gx = (((short) packet[6]) << 8) | packet[7];
+		motions[i].gy = (((short) packet[8]) << 8) | packet[9];
+		motions[i].gz = (((short) packet[10]) << 8) | packet[11];
+
+		usec = tv.tv_usec - (long) (backlog - 1 - i) * samplePeriodUs;
+		motions[i].tv.tv_sec = tv.tv_sec + usec / 1000000;
+		motions[i].tv.tv_usec = usec % 1000000;
+		if (motions[i].tv.tv_usec < 0) {
+			motions[i].tv.tv_sec -= 1;
+			motions[i].tv.tv_usec += 1000000;
+		}
+	}
+
+	return count;
 }
+#endif
 
+#ifdef MPU6050_9AXIS
 /**
- * get raw magnet data
+ * get raw magnet data, ST1, data and ST2 are read in one burst,
+ * reading ST2 tells AK8963 that the data are read so the next measurement can update them
+ *
+ * In bypass mode AK8963 is read directly, otherwise the data are taken from EXT_SENS_DATA
+ * which the I2C master of MPU6050 keeps refreshing every sample. Because the I2C master reads ST2 itself,
+ * DRDY is only seen in the first sample after a measurement, so it is not checked in that mode.
  *
  * @param mx
  * 		raw magnet data x
@@ -1295,23 +1554,51 @@ bool magnetDataIsReady(){
  * 		raw magnet data z
  *
  * @return bool
- *		data is valid or not
+ *		new data are ready and valid or not
  *
  */
 bool getMagnet(short* mx, short* my, short* mz) {
-	
-	readBytes(MPU9150_RA_MAG_ADDRESS, MPU9150_RA_MAG_XOUT_L, 7, buffer);
-	*mx = ((((short)buffer[1]) << 8) | buffer[0]);
-	*my = ((((short)buffer[3]) << 8) | buffer[2]);
-	*mz = ((((short)buffer[5]) << 8) | buffer[4]);
 
-	//_DEBUG(DEBUG_NORMAL,"0x%x 0x%x 0x%x 0x%x 0x%x 0x%x 0x%x 0x%x\n",buffer[0],buffer[1],buffer[2],buffer[3],buffer[4],buffer[5],buffer[6],buffer[7]);
+	unsigned char *data = buffer;
+
+#ifdef MPU6050_AUX_I2C_MAGNET
+#ifdef MPU6050_FIFO
+	// FIFO only carries accel and gyro, so EXT_SENS_DATA is read on its own
+	if (readBytes(devAddr, MPU6050_RA_EXT_SENS_DATA_00, AK8963_DATA_LENGTH,
+			buffer) != AK8963_DATA_LENGTH) {
+		return false;
+	}
+#else
+	if (!auxMagnetIsUpdated) {
+		return false;
+	}
+	auxMagnetIsUpdated = false;
+	data = auxMagnetBuffer;
+#endif
+#else
+	if (readBytes(MPU9150_RA_MAG_ADDRESS, MPU9150_RA_MAG_ST1, AK8963_DATA_LENGTH,
+			buffer) < 0) {
+		return false;
+	}
+
+	//_DEBUG(DEBUG_NORMAL,"ST1=0x%x ST2=0x%x\n",buffer[0],buffer[7]);
+	if (!(data[0] & AK8963_ST1_DRDY)) {
+		return false;
+	}
+#endif
+
+	*mx = ((((short)data[2]) << 8) | data[1]);
+	*my = ((((short)data[4]) << 8) | data[3]);
+	*mz = ((((short)data[6]) << 8) | data[5]);
+
 	//_DEBUG(DEBUG_NORMAL,"RAW mx=%d, my=%d, mz=%d\n",*mx,*my,*mz);
-	return !((buffer[6] & 0x08) == 0x08);
+	return !((data[7] & AK8963_ST2_HOFL) == AK8963_ST2_HOFL);
 }
 
 /**
- * This function is used to polling magnet data by the single measurement mode of AK8963
+ * This function is used to polling magnet data by the continuous measurement mode of AK8963,
+ * the bus is not accessed until a new measurement is due, so it costs one burst read per AK8963 sample
+ * however fast it is called (none if AK8963 is read by the I2C master of MPU6050 without FIFO)
  *
  * @param mx
  * 		magnet data x
@@ -1323,33 +1610,38 @@ bool getMagnet(short* mx, short* my, short* mz) {
  * 		magnet data z
  *
  * @return bool
- *		data is valid or not
+ *		new data are valid or not
  *
  */
-bool pollingMagnetDataBySingleMeasurementMode(short* mx, short* my, short* mz){
+bool pollingMagnetDataByContinuousMode(short* mx, short* my, short* mz){
 
-	bool result = false;
-	
-	if(singleMeasurementModeIsEnable()){
-
-		if(magnetDataIsReady()){
-			
-			if(getMagnet(mx, my, mz)){
-
-				result = true;
-				
-			}
-			
-			enableSingleMeasurementMode14Bit();
-			
-		}
-		
-	}else{
-	
-		enableSingleMeasurementMode14Bit();
+	struct timeval tv;
 
+	gettimeofday(&tv, NULL);
+	if (TIME_IS_UPDATED(lastMagnetSampleTv)
+			&& GET_USEC_TIMEDIFF(tv, lastMagnetSampleTv) < AK8963_SAMPLE_PERIOD) {
+		return false;
+	}
+
+	if (!getMagnet(mx, my, mz)) {
+		// DRDY is not set or the magnetic sensor overflows, try again in next call
+		return false;
 	}
-	return result;
+
+	UPDATE_LAST_TIME(tv, lastMagnetSampleTv);
+
+	return true;
+}
+
+/**
+ * get the interval between two AK8963 samples
+ *
+ * @return
+ *		period (us)
+ *
+ */
+unsigned long getMagnetSamplePeriod() {
+	return AK8963_SAMPLE_PERIOD;
 }
 #endif
 
@@ -24,4 +24,7 @@ SOFTWARE.
 
 bool ms5611Init();
 bool ms5611GetMeasurementData(unsigned short *cm);
+bool ms5611SetOsr(unsigned short v);
+unsigned short ms5611GetOsr();
+unsigned long ms5611GetUpdatePeriod();
 
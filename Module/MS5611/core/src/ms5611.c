@@ -26,10 +26,11 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
+#include <sys/time.h>
 #include "commonLib.h"
 #include "i2c.h"
 #include "kalmanFilter.h"
-#include "smaFilter.h"
+#include "filter.h"
 #include "ms5611.h"
 
 #define MS5611_ADDR_CSB_HIGH    0x76   
@@ -52,15 +53,35 @@
 #define CONST_SEA_PRESSURE 		1016.3f //Hsinchu city
 #define CONST_PF 				0.1902630958f //(1/5.25588f)
 #define CONST_PF2 				153.8461538461538f //(1/0.0065)
+#define MS5611_DEFAULT_OSR 		4096
+#define MS5611_TEMP_DECIMATION 	10 //read temperature once every N pressure conversions
+#define MS5611_CONVERSION_MARGIN 500 //us, update period is a little longer than conversion time
+#define MS5611_ALT_LUT_SIZE 	1024
+#define MS5611_ALT_LUT_MIN_PRESS 300.f //mbar, about 9000 m
+#define MS5611_ALT_LUT_MAX_PRESS 1100.f //mbar, below sea level
+#define MS5611_ALT_LUT_INV_STEP ((float)MS5611_ALT_LUT_SIZE / (MS5611_ALT_LUT_MAX_PRESS - MS5611_ALT_LUT_MIN_PRESS))
+#define CHECK_MS5611_ALTITUDE_LUT 0
+
+typedef enum {
+	MS5611_STATE_IDLE,
+	MS5611_STATE_CONVERTING_D1,
+	MS5611_STATE_CONVERTING_D2
+} MS5611_STATE;
 
 void readCalibrationDataFromProm();
+void buildAltitudeLut();
+float getAltitudeFactor(float press);
+#if CHECK_MS5611_ALTITUDE_LUT
+void checkAltitudeLut();
+#endif
 void sendPressCmdD1();
 float readPress();
 void sendTempCmdD2();
 float readTemp();
 char getPressD1Cmd();
 char getTempD2Cmd();
-void getDelay();
+unsigned long getConversionTime();
+void startConversion(MS5611_STATE nextState);
 void resetMs5611();
 float kalmanFilterOneDim(float inData);
 
@@ -68,12 +89,24 @@ static unsigned short osr;
 static unsigned short calibration[6];
 static float deltaTemp;   //dt
 static float temperature;
-static SMA_STRUCT ms5611SmaFilterEntry;
+static float temperatureCelsius;
+static FILTER_STRUCT ms5611SmaFilterEntry;
+static MS5611_STATE state;
+static struct timeval conversionStart_tv;
+static unsigned long conversionTime; //us, conversion time of the conversion in progress
+static unsigned char pressureCount; //pressure conversions since last temperature conversion
+static float sensT1; //C1 * 2^15
+static float offT1; //C2 * 2^16
+static float tcs; //C3 / 2^8
+static float tco; //C4 / 2^7
+static float pressSens; //SENS - SENS2 at current temperature
+static float pressOffset; //OFF - OFF2 at current temperature
+static float altitudeLut[MS5611_ALT_LUT_SIZE + 1]; //(Sea-level pressure/pressure)^(1/5.257)-1
 
 #define MS5611_KALMAN 0
 
 #if MS5611_KALMAN
-static KALMAN_1D_STRUCT ms5611KalmanFilterEntry;
+static FILTER_STRUCT ms5611KalmanFilterEntry;
 #endif
 
 /**
@@ -95,62 +128,165 @@ bool ms5611Init() {
 		return false;
 	}
 
-	initSmaFilterEntity(&ms5611SmaFilterEntry, "MS5611", 100);
+	initSmaFilter(&ms5611SmaFilterEntry, "MS5611", 100);
 #if MS5611_KALMAN
-	initkalmanFilterOneDimEntity(&ms5611KalmanFilterEntry,"MS5611", 0.f,10.f,50.f,350.f, 0.f);
+	initKalmanFilter(&ms5611KalmanFilterEntry,"MS5611", 0.f,10.f,50.f,350.f, 0.f);
 #endif
 
-	osr = 4096;
+	osr = MS5611_DEFAULT_OSR;
 	deltaTemp = 0;
 	temperature = 0;
+	temperatureCelsius = 0;
+	state = MS5611_STATE_IDLE;
+	pressureCount = 0;
 	resetMs5611();
 	usleep(20000);
 	readCalibrationDataFromProm();
+	buildAltitudeLut();
+#if CHECK_MS5611_ALTITUDE_LUT
+	checkAltitudeLut();
+#endif
 
 	return true;
 }
 
 /**
- * get temperature and pressure from MS5611 and calculate attitude
+ * drive the conversion state machine of MS5611 and calculate altitude, it never waits for a conversion:
+ * a conversion is started and the function returns, the result is collected by a later call after conversion time,
+ * temperature is converted once every MS5611_TEMP_DECIMATION pressure conversions
  *
  * @param cm
  * 		altitude
  *
  * @return
- *		bool
+ *		true if a new altitude is calculated
  *
  */
 bool ms5611GetMeasurementData(unsigned short *cm) {
 
-	float tmp = 0;
 	float press = 0;
 	float rawAltitude = 0.f;
+	struct timeval tv;
 
-	//send cmd D2 and read tmp
-	sendTempCmdD2();
-	getDelay();
-	tmp = readTemp();
+	if (MS5611_STATE_IDLE == state) {
+		startConversion(MS5611_STATE_CONVERTING_D2);
+		return false;
+	}
+
+	gettimeofday(&tv, NULL);
+	if (GET_USEC_TIMEDIFF(tv, conversionStart_tv) < conversionTime) {
+		return false;
+	}
+
+	if (MS5611_STATE_CONVERTING_D2 == state) {
+
+		temperatureCelsius = readTemp();
+		pressureCount = 0;
+		startConversion(MS5611_STATE_CONVERTING_D1);
+		return false;
+	}
 
-	//send cmd D1 and read press
-	sendPressCmdD1();
-	getDelay();
 	press = readPress();
 
+	// start next conversion before calculating, so it runs while the altitude is calculated
+	if (++pressureCount >= MS5611_TEMP_DECIMATION) {
+		startConversion(MS5611_STATE_CONVERTING_D2);
+	} else {
+		startConversion(MS5611_STATE_CONVERTING_D1);
+	}
+
 	//altitude = ( ( (Sea-level pressure/Atmospheric pressure)^ (1/5.257)-1 ) * (temperature+273.15))/0.0065
-	rawAltitude = ((powf((CONST_SEA_PRESSURE / press), CONST_PF) - 1.0f)
-			* (tmp + 273.15f)) * CONST_PF2 * 100.f;
+	rawAltitude = (getAltitudeFactor(press)
+			* (temperatureCelsius + 273.15f)) * CONST_PF2 * 100.f;
 #if MS5611_KALMAN	
-	pushSmaData(&ms5611SmaFilterEntry,kalmanFilterOneDimCalc(rawAltitude,&ms5611KalmanFilterEntry));
+	*cm = (unsigned short) filterUpdate(&ms5611SmaFilterEntry,
+			filterUpdate(&ms5611KalmanFilterEntry, rawAltitude));
 #else
-	pushSmaData(&ms5611SmaFilterEntry, rawAltitude);
+	*cm = (unsigned short) filterUpdate(&ms5611SmaFilterEntry, rawAltitude);
 #endif
-	*cm = (unsigned short) pullSmaData(&ms5611SmaFilterEntry);
 
-	//_DEBUG(DEBUG_NORMAL, "rawAltitude=%.2f, *cm=%d, mbar=%.2f, temp=%.2f\n", rawAltitude,*cm,press, tmp);
+	//_DEBUG(DEBUG_NORMAL, "rawAltitude=%.2f, *cm=%d, mbar=%.2f, temp=%.2f\n", rawAltitude,*cm,press, temperatureCelsius);
 
 	return true;
 }
 
+/**
+ * set OSR, it takes effect from next conversion
+ *
+ * @param v
+ * 		256, 512, 1024, 2048 or 4096
+ *
+ * @return
+ *		bool
+ *
+ */
+bool ms5611SetOsr(unsigned short v) {
+
+	switch (v) {
+	case 256:
+	case 512:
+	case 1024:
+	case 2048:
+	case 4096:
+		osr = v;
+		return true;
+	default:
+		_ERROR("(%s-%d) invalid OSR %d\n", __func__, __LINE__, v);
+		return false;
+	}
+}
+
+/**
+ * get OSR
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		OSR
+ *
+ */
+unsigned short ms5611GetOsr() {
+	return osr;
+}
+
+/**
+ * get the period to call ms5611GetMeasurementData, one conversion is finished in every period
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		period (us)
+ *
+ */
+unsigned long ms5611GetUpdatePeriod() {
+	return getConversionTime() + MS5611_CONVERSION_MARGIN;
+}
+
+/**
+ * start a conversion of pressure or temperature
+ *
+ * @param nextState
+ * 		MS5611_STATE_CONVERTING_D1 or MS5611_STATE_CONVERTING_D2
+ *
+ * @return
+ *		void
+ *
+ */
+void startConversion(MS5611_STATE nextState) {
+
+	if (MS5611_STATE_CONVERTING_D2 == nextState) {
+		sendTempCmdD2();
+	} else {
+		sendPressCmdD1();
+	}
+
+	gettimeofday(&conversionStart_tv, NULL);
+	conversionTime = getConversionTime();
+	state = nextState;
+}
+
 /**
  * reset MS5611
  *
@@ -206,7 +342,119 @@ void readCalibrationDataFromProm() {
 	_DEBUG(DEBUG_NORMAL, "Ms5611 calibbration data: %d %d %d %d %d %d\n",
 			calibration[0], calibration[1], calibration[2], calibration[3],
 			calibration[4], calibration[5]);
+
+	sensT1 = (float) calibration[0] * 32768.f;
+	offT1 = (float) calibration[1] * 65536.f;
+	tcs = (float) calibration[2] * 0.00390625f;
+	tco = (float) calibration[3] * 0.0078125f;
+	pressSens = sensT1;
+	pressOffset = offT1;
+}
+
+/**
+ * build the table of (Sea-level pressure/pressure)^(1/5.257)-1 from MS5611_ALT_LUT_MIN_PRESS to MS5611_ALT_LUT_MAX_PRESS,
+ * with 1024 entries the error of linear interpolation is less than 1.5 cm of altitude
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		void
+ *
+ */
+void buildAltitudeLut() {
+
+	int i;
+
+	for (i = 0; i <= MS5611_ALT_LUT_SIZE; i++) {
+		altitudeLut[i] = powf(CONST_SEA_PRESSURE
+						/ (MS5611_ALT_LUT_MIN_PRESS + (float) i / MS5611_ALT_LUT_INV_STEP),
+						CONST_PF) - 1.0f;
+	}
+}
+
+/**
+ * get (Sea-level pressure/pressure)^(1/5.257)-1 by linear interpolation of the table,
+ * powf is only used if pressure is out of the table
+ *
+ * @param press
+ * 		pressure (mbar)
+ *
+ * @return
+ *		altitude factor
+ *
+ */
+float getAltitudeFactor(float press) {
+
+	float index;
+	int i;
+
+	if (press < MS5611_ALT_LUT_MIN_PRESS || press >= MS5611_ALT_LUT_MAX_PRESS) {
+		return powf((CONST_SEA_PRESSURE / press), CONST_PF) - 1.0f;
+	}
+
+	index = (press - MS5611_ALT_LUT_MIN_PRESS) * MS5611_ALT_LUT_INV_STEP;
+	i = (int) index;
+
+	return altitudeLut[i] + (altitudeLut[i + 1] - altitudeLut[i]) * (index - i);
+}
+
+#if CHECK_MS5611_ALTITUDE_LUT
+/**
+ * compare the table with powf over the whole table range, and measure the time of both
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		void
+ *
+ */
+void checkAltitudeLut() {
+
+	struct timeval start_tv;
+	struct timeval end_tv;
+	volatile float sink = 0.f;
+	float press = 0.f;
+	float error = 0.f;
+	float maxError = 0.f;
+	float maxErrorPress = 0.f;
+	unsigned long lutTime = 0;
+	unsigned long powfTime = 0;
+
+	// 85 Celsius is the worst case of the error in cm
+	for (press = MS5611_ALT_LUT_MIN_PRESS; press < MS5611_ALT_LUT_MAX_PRESS;
+			press += 0.01f) {
+		error = fabsf(getAltitudeFactor(press)
+						- (powf((CONST_SEA_PRESSURE / press), CONST_PF) - 1.0f))
+				* (85.f + 273.15f) * CONST_PF2 * 100.f;
+		if (error > maxError) {
+			maxError = error;
+			maxErrorPress = press;
+		}
+	}
+
+	gettimeofday(&start_tv, NULL);
+	for (press = MS5611_ALT_LUT_MIN_PRESS; press < MS5611_ALT_LUT_MAX_PRESS;
+			press += 0.01f) {
+		sink += getAltitudeFactor(press);
+	}
+	gettimeofday(&end_tv, NULL);
+	lutTime = GET_USEC_TIMEDIFF(end_tv, start_tv);
+
+	gettimeofday(&start_tv, NULL);
+	for (press = MS5611_ALT_LUT_MIN_PRESS; press < MS5611_ALT_LUT_MAX_PRESS;
+			press += 0.01f) {
+		sink += powf((CONST_SEA_PRESSURE / press), CONST_PF) - 1.0f;
+	}
+	gettimeofday(&end_tv, NULL);
+	powfTime = GET_USEC_TIMEDIFF(end_tv, start_tv);
+
+	_DEBUG(DEBUG_NORMAL,
+			"altitude table: max error=%.3f cm at %.2f mbar, table=%ld us, powf=%ld us\n",
+			maxError, maxErrorPress, lutTime, powfTime);
 }
+#endif
 
 /**
  * send cmd D1 befor read pressure data:
@@ -249,50 +497,14 @@ void sendTempCmdD2() {
 float readPress() {
 
 	unsigned char data[3];
-	float offset = 0.f;
-	float sens = 0.f;
-	float offset2 = 0.f;
-	float sens2 = 0.f;
 	unsigned long rawPressure = 0;
-	float pressureUnscaled = 0.f;
 
 	readBytes(MS5611_ADDR_CSB_LOW, MS5611_ADC_READ, 3, data);
 	rawPressure = (data[0] << 16) | (data[1] << 8) | (data[2] << 0);
 
-	//SENS = C1 * 2^15 + (C3 * dT) / 2^8
-	sens = (float) calibration[0] * 32768.f
-			+ (float) calibration[2] * deltaTemp * 0.00390625f;
-	//OFF = C2 * 2^16 + (C4* dT) / 2^7
-	offset = (float) calibration[1] * 65536.f
-			+ (float) calibration[3] * deltaTemp * 0.0078125f;
-
-	// second order temperature compensation
-	if (temperature < 2000.f) {
-
-		//OFF2 = 5 *((TEMP V 2000)^2 )/ 2^1
-		offset2 = 2.5f * (temperature - 2000.f) * (temperature - 2000.f);
-		//SENS2 = 5 *(TEMP V 2000)^2/ 2^2
-		sens2 = 1.25f * (temperature - 2000.f) * (temperature - 2000.f);
-
-		if (temperature < -1500.f) {
-			//OFF2 = OFF2 + 7 *(TEMP + 1500)^2
-			offset2 = offset2
-					+ 7.f * (temperature + 1500.f) * (temperature + 1500.f);
-			//SENS2 = SENS2 + (11 * (TEMP + 1500)^2)/ 2^1
-			sens2 = sens2
-					+ (5.5f * (temperature + 1500.f) * (temperature + 1500.f));
-		}
-	}
-
-	//OFF = OFF - OFF2
-	//SENS = SENS - SENS2
-	//P = (D1 * SENS / 2^21 - OFF) / 2^15
-	pressureUnscaled =
-			(((rawPressure * (sens - sens2)) * 0.000000476837158203125f
-					- (offset - offset2)) * 0.000030517578125) * 0.01f;
-
-	return pressureUnscaled;
-
+	//P = (D1 * SENS / 2^21 - OFF) / 2^15, SENS and OFF are compensated by readTemp
+	return (((rawPressure * pressSens) * 0.000000476837158203125f - pressOffset)
+			* 0.000030517578125) * 0.01f;
 }
 
 /**
@@ -310,6 +522,10 @@ float readTemp() {
 	unsigned char data[3];
 	unsigned int rawTemperature = 0;
 	float tempOutput = 0.f;
+	float offset = 0.f;
+	float sens = 0.f;
+	float offset2 = 0.f;
+	float sens2 = 0.f;
 
 	readBytes(MS5611_ADDR_CSB_LOW, MS5611_ADC_READ, 3, data);
 	rawTemperature = (data[0] << 16) | (data[1] << 8) | (data[2] << 0);
@@ -321,14 +537,39 @@ float readTemp() {
 	tempOutput = temperature = (2000.f
 			+ (deltaTemp * calibration[5]) * 0.00000011920928955078125f);
 
+	//SENS = C1 * 2^15 + (C3 * dT) / 2^8
+	sens = sensT1 + tcs * deltaTemp;
+	//OFF = C2 * 2^16 + (C4* dT) / 2^7
+	offset = offT1 + tco * deltaTemp;
+
 	// second order temperature compensation
 	if (temperature < 2000.f) {
 		//T2 = dT^2 / 2^31
 		//TEMP = TEMP - T2
 		tempOutput = temperature
 				- (deltaTemp * deltaTemp * 0.0000000004656612873077392578125f);
+
+		//OFF2 = 5 *((TEMP - 2000)^2 )/ 2^1
+		offset2 = 2.5f * (temperature - 2000.f) * (temperature - 2000.f);
+		//SENS2 = 5 *(TEMP - 2000)^2/ 2^2
+		sens2 = 1.25f * (temperature - 2000.f) * (temperature - 2000.f);
+
+		if (temperature < -1500.f) {
+			//OFF2 = OFF2 + 7 *(TEMP + 1500)^2
+			offset2 = offset2
+					+ 7.f * (temperature + 1500.f) * (temperature + 1500.f);
+			//SENS2 = SENS2 + (11 * (TEMP + 1500)^2)/ 2^1
+			sens2 = sens2
+					+ (5.5f * (temperature + 1500.f) * (temperature + 1500.f));
+		}
 	}
 
+	//OFF = OFF - OFF2
+	//SENS = SENS - SENS2
+	//they are used by readPress until next temperature conversion
+	pressSens = sens - sens2;
+	pressOffset = offset - offset2;
+
 	return (tempOutput) * 0.01f;
 }
 
@@ -390,35 +631,31 @@ char getTempD2Cmd() {
 }
 
 /**
- * get delay by OSR setting
+ * get maximum conversion time by OSR setting
  *
  * @param
  * 		void
  *
  * @return
- *		command
+ *		conversion time (us)
  *
  */
-void getDelay() {
+unsigned long getConversionTime() {
 
 	switch (osr) {
 	case 256:
-		usleep(2000);
-		break;
+		return 600;
 	case 512:
-		usleep(2000);
-		break;
+		return 1170;
 	case 1024:
-		usleep(3000);
-		break;
+		return 2280;
 	case 2048:
-		usleep(5000);
-		break;
+		return 4540;
 	case 4096:
-		usleep(9000);
-		break;
+		return 9040;
 	default:
 		break;
 	}
+	return 9040;
 }
 
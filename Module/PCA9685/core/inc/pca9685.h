@@ -26,4 +26,6 @@ bool pca9685Init();
 void resetPca9685(void);
 void pca9685SetPwmFreq(unsigned short);
 void pca9685SetPwm(unsigned char, unsigned short);
+void pca9685SetPwmMulti(unsigned char *channels, unsigned short *values,
+		unsigned char count);
 
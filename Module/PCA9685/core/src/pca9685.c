@@ -29,6 +29,7 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <math.h>
+#include <sys/time.h>
 #include "commonLib.h"
 #include "i2c.h"
 #include "pca9685.h"
@@ -43,8 +44,18 @@
 #define PCA9685_PRE_SCALE 		0xFE			//prescaler for output frequency
 #define PCA9685_LED_SHIFT 		4				// register shift per channel
 #define PCA9685_CLOCK_FREQ 		25000000.f 		//25MHz default osc clock
+#define PCA9685_MODE1_AI 		0x20			//register auto-increment
+#define PCA9685_CHANNEL_NUM 		16
+#define PCA9685_FORCED_REFRESH_PERIOD 	1000000 		//us, rewrite all channels even if they don't change
 
 static bool PCA9685_initSuccess = false;
+static unsigned short pwmShadow[PCA9685_CHANNEL_NUM]; //last PWM value written into LEDn_OFF
+static unsigned short pwmShadowValid = 0; //bit mask of channels whose shadow matches the device
+static struct timeval lastRefresh_tv;
+
+static void invalidatePwmShadow();
+static bool pca9685WritePwm(unsigned char *channels, unsigned short *values,
+		unsigned char count);
 
 /**
  * Init PCA9685
@@ -84,8 +95,10 @@ void resetPca9685() {
 
 	if (true == PCA9685_initSuccess) {
 
-		//sleep mode, Low power mode. Oscillator off
-		writeByte(PCA9685_ADDRESS, PCA9685_MODE1, 0x00);
+		invalidatePwmShadow();
+
+		//sleep mode, Low power mode. Oscillator off, register auto-increment for burst writes
+		writeByte(PCA9685_ADDRESS, PCA9685_MODE1, PCA9685_MODE1_AI);
 		writeByte(PCA9685_ADDRESS, PCA9685_MODE2, 0x04);
 		usleep(1000);
 
@@ -130,6 +143,8 @@ void pca9685SetPwmFreq(unsigned short freq) {
 	_DEBUG(DEBUG_NORMAL, "(%s-%d) set PWM frequency to %d HZ\n", __func__,
 			__LINE__, freq);
 
+	invalidatePwmShadow();
+
 	//read old mode
 	readByte(PCA9685_ADDRESS, PCA9685_MODE1, &oldMode);
 	//setup sleep mode, Low power mode. Oscillator off (bit4: 1-sleep, 0-normal)
@@ -179,6 +194,34 @@ void pca9685SetPwmFreq(unsigned short freq) {
  *
  */
 void pca9685SetPwm(unsigned char channel, unsigned short value) {
+	pca9685SetPwmMulti(&channel, &value, 1);
+}
+
+/**
+ * set PWM signal of several channels, only the channels whose value differs from the shadow are written,
+ * all channels are rewritten every PCA9685_FORCED_REFRESH_PERIOD in case the device was reset
+ *
+ * @param channels
+ * 		channel indexes
+ *
+ * @param values
+ * 		PWM values from 0 to 4095
+ *
+ * @param count
+ * 		number of channels
+ *
+ * @return
+ *		void
+ *
+ */
+void pca9685SetPwmMulti(unsigned char *channels, unsigned short *values,
+		unsigned char count) {
+
+	unsigned char changedChannels[PCA9685_CHANNEL_NUM];
+	unsigned short changedValues[PCA9685_CHANNEL_NUM];
+	unsigned char changedCount = 0;
+	struct timeval tv;
+	unsigned char i;
 
 	if (!PCA9685_initSuccess) {
 		_ERROR("(%s-%d)  PCA9685_initSuccess=%d\n", __func__, __LINE__,
@@ -186,10 +229,124 @@ void pca9685SetPwm(unsigned char channel, unsigned short value) {
 		return;
 	}
 
-	writeByte(PCA9685_ADDRESS,
-			PCA9685_LED0_OFF_L + PCA9685_LED_SHIFT * channel, value & 0xFF);
-					
-	writeByte(PCA9685_ADDRESS,
-					PCA9685_LED0_OFF_H + PCA9685_LED_SHIFT * channel, value >> 8);
+	if (count == 0 || count > PCA9685_CHANNEL_NUM) {
+		_ERROR("(%s-%d) invalid count %d\n", __func__, __LINE__, count);
+		return;
+	}
+
+	gettimeofday(&tv, NULL);
+	if (GET_USEC_TIMEDIFF(tv, lastRefresh_tv) >= PCA9685_FORCED_REFRESH_PERIOD) {
+		invalidatePwmShadow();
+		UPDATE_LAST_TIME(tv, lastRefresh_tv);
+	}
+
+	for (i = 0; i < count; i++) {
+
+		if (channels[i] >= PCA9685_CHANNEL_NUM) {
+			_ERROR("(%s-%d) invalid channel %d\n", __func__, __LINE__,
+					channels[i]);
+			return;
+		}
+
+		if (!(pwmShadowValid & (1 << channels[i]))
+				|| pwmShadow[channels[i]] != values[i]) {
+			changedChannels[changedCount] = channels[i];
+			changedValues[changedCount] = values[i];
+			changedCount++;
+		}
+	}
+
+	if (changedCount == 0) {
+		return;
+	}
+
+	if (pca9685WritePwm(changedChannels, changedValues, changedCount)) {
+		for (i = 0; i < changedCount; i++) {
+			pwmShadow[changedChannels[i]] = changedValues[i];
+			pwmShadowValid |= 1 << changedChannels[i];
+		}
+	} else {
+		invalidatePwmShadow();
+	}
+}
+
+/**
+ * write PWM signal of several channels in one I2C transaction,
+ * a single burst is written if the channels are contiguous, otherwise every channel is a message of one I2C_RDWR batch,
+ * the outputs change together on the STOP condition at the end of the transaction
+ *
+ * @param channels
+ * 		valid channel indexes
+ *
+ * @param values
+ * 		PWM values from 0 to 4095
+ *
+ * @param count
+ * 		number of channels, from 1 to PCA9685_CHANNEL_NUM
+ *
+ * @return
+ *		bool
+ *
+ */
+static bool pca9685WritePwm(unsigned char *channels, unsigned short *values,
+		unsigned char count) {
+
+	unsigned char buf[PCA9685_CHANNEL_NUM * PCA9685_LED_SHIFT];
+	I2C_WRITE_REQUEST_STRUCT requests[PCA9685_CHANNEL_NUM];
+	unsigned char firstChannel = PCA9685_CHANNEL_NUM;
+	unsigned short coveredChannels = 0;
+	bool isContiguous = true;
+	unsigned char *reg;
+	unsigned char i;
+
+	for (i = 0; i < count; i++) {
+		firstChannel = min(firstChannel, channels[i]);
+		coveredChannels |= 1 << channels[i];
+	}
+
+	for (i = 0; i < count; i++) {
+		if (!(coveredChannels & (1 << (firstChannel + i)))) {
+			isContiguous = false;
+		}
+	}
+
+	for (i = 0; i < count; i++) {
+
+		// ON time is 0, OFF time is the PWM value
+		reg = buf
+				+ PCA9685_LED_SHIFT
+						* (isContiguous ? (channels[i] - firstChannel) : i);
+		reg[0] = 0;
+		reg[1] = 0;
+		reg[2] = values[i] & 0xFF;
+		reg[3] = values[i] >> 8;
+
+		requests[i].devAddr = PCA9685_ADDRESS;
+		requests[i].regAddr = PCA9685_LED0_ON_L
+				+ PCA9685_LED_SHIFT * channels[i];
+		requests[i].length = PCA9685_LED_SHIFT;
+		requests[i].data = reg;
+	}
+
+	if (isContiguous) {
+		return writeBytes(PCA9685_ADDRESS,
+				PCA9685_LED0_ON_L + PCA9685_LED_SHIFT * firstChannel,
+				PCA9685_LED_SHIFT * count, buf);
+	} else {
+		return writeBytesBatch(requests, count);
+	}
 }
 
+/**
+ * mark all channels as unknown, so they are written by next update
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		void
+ *
+ */
+static void invalidatePwmShadow() {
+	pwmShadowValid = 0;
+}
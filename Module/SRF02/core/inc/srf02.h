@@ -22,6 +22,14 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 ******************************************************************************/
 
+typedef enum {
+	SRF02_STATE_IDLE, SRF02_STATE_RANGING
+} SRF02_STATE;
+
 bool srf02Init();
 bool srf02GetMeasurementData(unsigned short *cm);
+unsigned long srf02GetUpdatePeriod();
+unsigned long srf02GetMaxLatency();
+void srf02GetMeasurementTv(struct timeval *tv);
+void srf02PrintStatistics();
 
@@ -25,16 +25,33 @@ SOFTWARE.
 #include <stdlib.h>
 #include <stdio.h>
 #include <unistd.h>
+#include <sys/time.h>
 #include "commonLib.h"
 #include "kalmanFilter.h"
+#include "filter.h"
 #include "i2c.h"
+#include "srf02.h"
 
 #define SRF02_ADD   		0x70
 #define SRF02_REG_CMD       0x00
+#define SRF02_REG_REVISION  0x00 //reads 0xFF while ranging
 #define SRF02_REG_RANGE_H   0x02
 #define SRF02_CMD_CM      	0x51
+#define SRF02_RANGING_BUSY  0xFF
+#define SRF02_POLL_START    60000 //us, ranging never finishes earlier, so the bus is not touched before it
+#define SRF02_RANGING_DEADLINE 70000 //us, ranging always finishes in it
+#define SRF02_POLL_PERIOD   2000 //us
 
-static KALMAN_1D_STRUCT srf02KalmanFilterEntry;
+static void startRanging();
+
+static FILTER_STRUCT srf02KalmanFilterEntry;
+static SRF02_STATE state;
+static struct timeval ping_tv;
+static struct timeval measurement_tv; // ping of the latest collected range
+static struct timeval statisticsStart_tv;
+static unsigned long rangingCount;
+static unsigned long totalLatency; //us
+static unsigned long maxLatency; //us
 
 
 /**
@@ -56,41 +73,157 @@ bool srf02Init(){
 		return false;
 	}
 
-	initkalmanFilterOneDimEntity(&srf02KalmanFilterEntry,"SRF02", 0.f,10.f,1.f,5.f, 0.f);
+	initKalmanFilter(&srf02KalmanFilterEntry,"SRF02", 0.f,10.f,1.f,5.f, 0.f);
+	state = SRF02_STATE_IDLE;
+	gettimeofday(&statisticsStart_tv, NULL);
+	rangingCount = 0;
+	totalLatency = 0;
+	maxLatency = 0;
 
 	return true;
 	
 }
 
 /**
- * get measurement data from SRF02
+ * drive the ranging of SRF02, it never waits for a ranging:
+ * a ping is fired and the function returns, later calls poll the revision register
+ * which reads 0xFF while ranging, the range is collected once it is finished or the deadline is passed
  *
- * @param
- * 		data
+ * @param cm
+ * 		distance
  *
  * @return
- *		bool
+ *		true if a new distance is collected
  *
  */
 bool srf02GetMeasurementData(unsigned short *cm){
 
-
-	bool result=true;
 	unsigned char data[2];
+	unsigned char revision = SRF02_RANGING_BUSY;
+	unsigned long latency = 0;
+	struct timeval tv;
 
-	result=writeByte(SRF02_ADD,SRF02_REG_CMD,SRF02_CMD_CM);
-	if(!result) return false;
+	if (SRF02_STATE_IDLE == state) {
+		startRanging();
+		return false;
+	}
 
-	usleep(70000);
+	gettimeofday(&tv, NULL);
+	latency = GET_USEC_TIMEDIFF(tv, ping_tv);
 
-	result=(readBytes(SRF02_ADD,SRF02_REG_RANGE_H,2,data)<0) ? false:true;
-	if(!result) return false;
-		
-	*cm =(unsigned short)kalmanFilterOneDimCalc(((data[0] << 8) | data[1]) ,&srf02KalmanFilterEntry);
+	if (latency < SRF02_POLL_START) {
+		return false;
+	}
 
-	usleep(500);
+	if (latency < SRF02_RANGING_DEADLINE) {
+		if (readByte(SRF02_ADD, SRF02_REG_REVISION, &revision) < 0
+				|| SRF02_RANGING_BUSY == revision) {
+			return false;
+		}
+	}
+
+	if (readBytes(SRF02_ADD, SRF02_REG_RANGE_H, 2, data) < 0) {
+		startRanging();
+		return false;
+	}
+
+	measurement_tv = ping_tv;
+	startRanging();
+
+	rangingCount++;
+	totalLatency += latency;
+	maxLatency = max(maxLatency, latency);
+
+	*cm =(unsigned short)filterUpdate(&srf02KalmanFilterEntry, ((data[0] << 8) | data[1]));
 
 	return true;
 }
 
+/**
+ * get the period to call srf02GetMeasurementData
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		period (us)
+ *
+ */
+unsigned long srf02GetUpdatePeriod() {
+	return SRF02_POLL_PERIOD;
+}
+
+/**
+ * get the time of the latest collected range, it is the time its ping was fired
+ *
+ * @param tv
+ * 		time of measurement
+ *
+ * @return
+ *		void
+ *
+ */
+void srf02GetMeasurementTv(struct timeval *tv) {
+	*tv = measurement_tv;
+}
+
+/**
+ * get the longest time from a ping to the collection of its range
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		latency (us)
+ *
+ */
+unsigned long srf02GetMaxLatency() {
+	return SRF02_RANGING_DEADLINE + SRF02_POLL_PERIOD;
+}
+
+/**
+ * print achieved ranging rate and latency from ping to collection since last call
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		void
+ *
+ */
+void srf02PrintStatistics() {
+
+	struct timeval tv;
+	float elapsed = 0.f;
+
+	gettimeofday(&tv, NULL);
+	elapsed = GET_SEC_TIMEDIFF(tv, statisticsStart_tv);
+
+	_DEBUG_HOVER(DEBUG_HOVER_STATISTICS,
+			"SRF02: rate=%.2f Hz, average latency=%ld us, max latency=%ld us\n",
+			(elapsed > 0.f) ? (float) rangingCount / elapsed : 0.f,
+			rangingCount ? totalLatency / rangingCount : 0, maxLatency);
+
+	UPDATE_LAST_TIME(tv, statisticsStart_tv);
+	rangingCount = 0;
+	totalLatency = 0;
+	maxLatency = 0;
+}
+
+/**
+ * fire a ping of SRF02
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		void
+ *
+ */
+void startRanging() {
+
+	gettimeofday(&ping_tv, NULL);
+	state = writeByte(SRF02_ADD, SRF02_REG_CMD, SRF02_CMD_CM) ?
+			SRF02_STATE_RANGING : SRF02_STATE_IDLE;
+}
 
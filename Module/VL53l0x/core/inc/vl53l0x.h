@@ -22,6 +22,19 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 ******************************************************************************/
 
+typedef struct {
+	unsigned int refSpadCount;
+	unsigned char isApertureSpads;
+	unsigned char vhvSettings;
+	unsigned char phaseCal;
+} VL53L0X_CALIBRATION_STRUCT;
+
 bool vl53l0xInit();
 bool vl53l0xGetMeasurementData(unsigned short *cm);
+bool vl53l0xSetTimingBudget(unsigned long budget);
+unsigned long vl53l0xGetTimingBudget();
+void vl53l0xRequestCalibration();
+bool vl53l0xCancelCalibration();
+unsigned long vl53l0xGetUpdatePeriod();
+void vl53l0xPrintStatistics();
 
@@ -24,24 +24,69 @@ SOFTWARE.
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#ifdef VL53L0X_GPIO1_INTERRUPT
+#include <semaphore.h>
+#include <wiringPi.h>
+#endif
 #include "vl53l0x_api.h"
 #include "vl53l0x_platform.h"
+#include "cJSON.h"
 #include "commonLib.h"
 #include "i2c.h"
 #include "kalmanFilter.h"
+#include "filter.h"
 #include "vl53l0x.h"
 
 #define VERSION_REQUIRED_MAJOR 1
 #define VERSION_REQUIRED_MINOR 0
 #define VERSION_REQUIRED_BUILD 1
 #define VL53L0X_ADDRESS 0x29
+#define VL53L0X_DEFAULT_TIMING_BUDGET 33000 //us
+#define VL53L0X_MIN_TIMING_BUDGET 20000 //us
+#define VL53L0X_MAX_TIMING_BUDGET 200000 //us
+#define VL53L0X_STOP_POLL_TIMES 50
+#define VL53L0X_STOP_POLL_DELAY 1000 //us
+#ifdef VL53L0X_GPIO1_INTERRUPT
+#define VL53L0X_POLL_PERIOD 1000 //us, only a semaphore is checked
+#else
+#define VL53L0X_POLL_PERIOD 2000 //us, status register is read
+#endif
 
 static VL53L0X_Dev_t vl53l0xDevice;
 static bool vl53l0xIsReady = false;
-static KALMAN_1D_STRUCT vl53l0KalmanFilterEntry;
-
-static VL53L0X_Error singleRangingLongRangeInit();
+static FILTER_STRUCT vl53l0KalmanFilterEntry;
+static unsigned long timingBudget = VL53L0X_DEFAULT_TIMING_BUDGET; //us
+static unsigned long pendingTimingBudget = 0; //us, applied between two measurements, 0 if nothing is pending
+static bool calibrationIsRequested = false;
+static struct timeval lastSample_tv;
+static struct timeval statisticsStart_tv;
+static unsigned long rangingCount;
+static unsigned long maxInterval; //us
+static unsigned long statisticsAccesses; //register accesses when statistics starts
+static unsigned long statisticsTransactions; //I2C transactions when statistics starts
+#ifdef VL53L0X_GPIO1_INTERRUPT
+static sem_t dataReadySem;
+static struct timeval dataReady_tv; // time of the latest completion or status check
+#endif
+
+static VL53L0X_Error continuousRangingLongRangeInit();
+static VL53L0X_Error applyTimingBudget(unsigned long budget);
+static VL53L0X_Error stopRanging();
+static void restartRanging();
+static VL53L0X_Error performRefCalibration();
+static VL53L0X_Error loadRefCalibration();
+static bool parseCalibrationData(VL53L0X_CALIBRATION_STRUCT *cal);
+static bool saveCalibrationData(VL53L0X_CALIBRATION_STRUCT *cal);
 static void print_pal_error(VL53L0X_Error Status);
+static void printI2cTransactions(char *name, unsigned long accesses,
+		unsigned long transactions);
+#ifdef VL53L0X_GPIO1_INTERRUPT
+static bool dataReadyInterruptInit();
+static void dataReadyIsr(void);
+#endif
 
 /**
  * init vl53l0x
@@ -61,7 +106,14 @@ bool vl53l0xInit() {
 	VL53L0X_DeviceInfo_t DeviceInfo;
 	VL53L0X_Dev_t *pVl53l0xDevice = &vl53l0xDevice;
 	int32_t status_int;
+	unsigned long accesses = VL53L0X_GetRegisterAccessCount();
+	unsigned long transactions = VL53L0X_GetTransactionCount();
+	unsigned long apiAccesses = 0;
+	unsigned long apiTransactions = 0;
+	struct timeval start_tv;
+	struct timeval tv;
 
+	gettimeofday(&start_tv, NULL);
 
 	if (checkI2cDeviceIsExist(VL53L0X_ADDRESS)) {
 		_DEBUG(DEBUG_NORMAL, "(%s-%d) VL53L0X_ exist\n", __func__, __LINE__);
@@ -70,7 +122,7 @@ bool vl53l0xInit() {
 		return false;
 	}
 
-	initkalmanFilterOneDimEntity(&vl53l0KalmanFilterEntry,"VL53L0", 0.f,10.f,1.f,5.f, 0.f);
+	initKalmanFilter(&vl53l0KalmanFilterEntry,"VL53L0", 0.f,10.f,1.f,5.f, 0.f);
 	
 	pVl53l0xDevice->I2cDevAddr = VL53L0X_ADDRESS;
 
@@ -103,7 +155,10 @@ bool vl53l0xInit() {
 
 	if (Status == VL53L0X_ERROR_NONE) {
 		_DEBUG(DEBUG_NORMAL,"Call of VL53L0X_DataInit\n");
+		apiAccesses = VL53L0X_GetRegisterAccessCount();
+		apiTransactions = VL53L0X_GetTransactionCount();
 		Status = VL53L0X_DataInit(&vl53l0xDevice); // Data initialization
+		printI2cTransactions("VL53L0X_DataInit", apiAccesses, apiTransactions);
 		print_pal_error(Status);
 	}
 
@@ -130,9 +185,27 @@ bool vl53l0xInit() {
 		print_pal_error(Status);
 	}
 
-	//single Ranging Long Range
+#ifdef VL53L0X_GPIO1_INTERRUPT
+	if (Status == VL53L0X_ERROR_NONE && !dataReadyInterruptInit())
+		Status = VL53L0X_ERROR_CONTROL_INTERFACE;
+#endif
+
+	//continuous Ranging Long Range
 	if (Status == VL53L0X_ERROR_NONE)
-		Status = singleRangingLongRangeInit();
+		Status = continuousRangingLongRangeInit();
+
+	gettimeofday(&statisticsStart_tv, NULL);
+	UPDATE_LAST_TIME(statisticsStart_tv, lastSample_tv);
+	rangingCount = 0;
+	maxInterval = 0;
+
+	statisticsAccesses = VL53L0X_GetRegisterAccessCount();
+	statisticsTransactions = VL53L0X_GetTransactionCount();
+
+	gettimeofday(&tv, NULL);
+	_DEBUG(DEBUG_NORMAL, "VL53L0X init takes %ld us\n",
+			GET_USEC_TIMEDIFF(tv, start_tv));
+	printI2cTransactions("vl53l0xInit", accesses, transactions);
 
 	vl53l0xIsReady = ((Status == VL53L0X_ERROR_NONE) ? true : false);
 
@@ -141,7 +214,8 @@ bool vl53l0xInit() {
 }
 
 /**
- * init vl53l0x single ranging and long range mode
+ * init vl53l0x continuous ranging and long range mode, measurements are started back-to-back
+ * and GPIO1 goes low when a new measurement is ready
  *
  * @param
  * 		void
@@ -150,46 +224,44 @@ bool vl53l0xInit() {
  *		error message
  *
  */
-VL53L0X_Error singleRangingLongRangeInit() {
+VL53L0X_Error continuousRangingLongRangeInit() {
 
 	VL53L0X_Error Status = VL53L0X_ERROR_NONE;
-	uint32_t refSpadCount;
-	uint8_t isApertureSpads;
-	uint8_t VhvSettings;
-	uint8_t PhaseCal;
 	VL53L0X_Dev_t *pDevice = &vl53l0xDevice;
+	unsigned long accesses = 0;
+	unsigned long transactions = 0;
 
 	if (Status == VL53L0X_ERROR_NONE) {
 		_DEBUG(DEBUG_NORMAL,"Call of VL53L0X_StaticInit\n");
+		accesses = VL53L0X_GetRegisterAccessCount();
+		transactions = VL53L0X_GetTransactionCount();
 		Status = VL53L0X_StaticInit(pDevice); // Device Initialization
+		printI2cTransactions("VL53L0X_StaticInit", accesses, transactions);
 		print_pal_error(Status);
 	}
 
+	// the reference calibration is stable for a sensor, run it only if no saved result can be applied
 	if (Status == VL53L0X_ERROR_NONE) {
-		_DEBUG(DEBUG_NORMAL,"Call of VL53L0X_PerformRefCalibration\n");
-		Status = VL53L0X_PerformRefCalibration(pDevice, &VhvSettings,
-				&PhaseCal); // Device Initialization
-		print_pal_error(Status);
-	}
-
-	if (Status == VL53L0X_ERROR_NONE) {
-		_DEBUG(DEBUG_NORMAL,"Call of VL53L0X_PerformRefSpadManagement\n");
-		Status = VL53L0X_PerformRefSpadManagement(pDevice, &refSpadCount,
-				&isApertureSpads); // Device Initialization
-		_DEBUG(DEBUG_NORMAL,"refSpadCount = %d, isApertureSpads = %d\n", refSpadCount,
-				isApertureSpads);
-		print_pal_error(Status);
+		if (loadRefCalibration() != VL53L0X_ERROR_NONE) {
+			Status = performRefCalibration();
+		}
 	}
 
 	if (Status == VL53L0X_ERROR_NONE) {
 
-		// no need to do this when we use VL53L0X_PerformSingleRangingMeasurement
 		_DEBUG(DEBUG_NORMAL,"Call of VL53L0X_SetDeviceMode\n");
 		Status = VL53L0X_SetDeviceMode(pDevice,
-				VL53L0X_DEVICEMODE_SINGLE_RANGING); // Setup in single ranging mode
+				VL53L0X_DEVICEMODE_CONTINUOUS_RANGING); // Setup in continuous ranging mode
 		print_pal_error(Status);
 	}
 
+	if (Status == VL53L0X_ERROR_NONE) {
+		Status = VL53L0X_SetGpioConfig(pDevice, 0,
+				VL53L0X_DEVICEMODE_CONTINUOUS_RANGING,
+				VL53L0X_GPIOFUNCTIONALITY_NEW_MEASURE_READY,
+				VL53L0X_INTERRUPTPOLARITY_LOW);
+	}
+
 	// Enable/Disable Sigma and Signal check
 	/*
 	 if (Status == VL53L0X_ERROR_NONE) {
@@ -219,7 +291,8 @@ VL53L0X_Error singleRangingLongRangeInit() {
 	}
 	
 	if (Status == VL53L0X_ERROR_NONE) {
-		Status = VL53L0X_SetMeasurementTimingBudgetMicroSeconds(pDevice, 33000);
+		Status = VL53L0X_SetMeasurementTimingBudgetMicroSeconds(pDevice,
+				timingBudget);
 	}
 
 	if (Status == VL53L0X_ERROR_NONE) {
@@ -232,9 +305,358 @@ VL53L0X_Error singleRangingLongRangeInit() {
 		VL53L0X_VCSEL_PERIOD_FINAL_RANGE, 14);
 	}
 
+	if (Status == VL53L0X_ERROR_NONE) {
+		Status = VL53L0X_ClearInterruptMask(pDevice,
+				VL53L0X_REG_SYSTEM_INTERRUPT_GPIO_NEW_SAMPLE_READY);
+	}
+
+	if (Status == VL53L0X_ERROR_NONE) {
+		_DEBUG(DEBUG_NORMAL,"Call of VL53L0X_StartMeasurement\n");
+		accesses = VL53L0X_GetRegisterAccessCount();
+		transactions = VL53L0X_GetTransactionCount();
+		Status = VL53L0X_StartMeasurement(pDevice);
+		if (Status == VL53L0X_ERROR_NONE) {
+			Status = VL53L0X_FlushWrites(pDevice);
+		}
+		printI2cTransactions("VL53L0X_StartMeasurement", accesses,
+				transactions);
+		print_pal_error(Status);
+	}
+
+	return Status;
+}
+
+/**
+ * stop continuous ranging, change timing budget and start again
+ *
+ * @param budget
+ * 		timing budget (us)
+ *
+ * @return
+ *		error message
+ *
+ */
+VL53L0X_Error applyTimingBudget(unsigned long budget) {
+
+	VL53L0X_Error Status = VL53L0X_ERROR_NONE;
+
+	Status = stopRanging();
+
+	if (Status == VL53L0X_ERROR_NONE) {
+		Status = VL53L0X_SetMeasurementTimingBudgetMicroSeconds(&vl53l0xDevice,
+				budget);
+	}
+
+	if (Status == VL53L0X_ERROR_NONE) {
+		timingBudget = budget;
+	} else {
+		_ERROR("(%s-%d) set timing budget %ld us failed\n", __func__,
+				__LINE__, budget);
+	}
+
+	// measurements must go on even if the new budget is rejected
+	restartRanging();
+
 	return Status;
 }
 
+/**
+ * stop continuous ranging and wait until the measurement in progress is finished
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		error message
+ *
+ */
+VL53L0X_Error stopRanging() {
+
+	VL53L0X_Error Status = VL53L0X_ERROR_NONE;
+	VL53L0X_Dev_t *pDevice = &vl53l0xDevice;
+	uint32_t stopStatus = 1;
+	unsigned char count = 0;
+
+	Status = VL53L0X_StopMeasurement(pDevice);
+
+	while (Status == VL53L0X_ERROR_NONE && stopStatus != 0
+			&& count++ < VL53L0X_STOP_POLL_TIMES) {
+		Status = VL53L0X_GetStopCompletedStatus(pDevice, &stopStatus);
+		if (stopStatus != 0) {
+			usleep(VL53L0X_STOP_POLL_DELAY);
+		}
+	}
+
+	return Status;
+}
+
+/**
+ * drop the measurement signalled before stop and start continuous ranging again
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		void
+ *
+ */
+void restartRanging() {
+
+	VL53L0X_Dev_t *pDevice = &vl53l0xDevice;
+
+	VL53L0X_ClearInterruptMask(pDevice,
+			VL53L0X_REG_SYSTEM_INTERRUPT_GPIO_NEW_SAMPLE_READY);
+#ifdef VL53L0X_GPIO1_INTERRUPT
+	while (sem_trywait(&dataReadySem) == 0) {
+	}
+#endif
+	if (VL53L0X_StartMeasurement(pDevice) != VL53L0X_ERROR_NONE
+			|| VL53L0X_FlushWrites(pDevice) != VL53L0X_ERROR_NONE) {
+		_ERROR("(%s-%d) restart measurement failed\n", __func__, __LINE__);
+	}
+}
+
+/**
+ * run reference SPAD management and reference (VHV and phase) calibration, and save the result
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		error message
+ *
+ */
+VL53L0X_Error performRefCalibration() {
+
+	VL53L0X_Error Status = VL53L0X_ERROR_NONE;
+	VL53L0X_Dev_t *pDevice = &vl53l0xDevice;
+	VL53L0X_CALIBRATION_STRUCT cal;
+	uint32_t refSpadCount;
+	uint8_t isApertureSpads;
+	uint8_t VhvSettings;
+	uint8_t PhaseCal;
+	unsigned long accesses = VL53L0X_GetRegisterAccessCount();
+	unsigned long transactions = VL53L0X_GetTransactionCount();
+
+	if (Status == VL53L0X_ERROR_NONE) {
+		_DEBUG(DEBUG_NORMAL,"Call of VL53L0X_PerformRefCalibration\n");
+		Status = VL53L0X_PerformRefCalibration(pDevice, &VhvSettings,
+				&PhaseCal); // Device Initialization
+		print_pal_error(Status);
+	}
+
+	if (Status == VL53L0X_ERROR_NONE) {
+		_DEBUG(DEBUG_NORMAL,"Call of VL53L0X_PerformRefSpadManagement\n");
+		Status = VL53L0X_PerformRefSpadManagement(pDevice, &refSpadCount,
+				&isApertureSpads); // Device Initialization
+		_DEBUG(DEBUG_NORMAL,"refSpadCount = %d, isApertureSpads = %d\n", refSpadCount,
+				isApertureSpads);
+		print_pal_error(Status);
+	}
+
+	printI2cTransactions("reference calibration", accesses, transactions);
+
+	if (Status == VL53L0X_ERROR_NONE) {
+
+		cal.refSpadCount = refSpadCount;
+		cal.isApertureSpads = isApertureSpads;
+		cal.vhvSettings = VhvSettings;
+		cal.phaseCal = PhaseCal;
+
+		if (!saveCalibrationData(&cal)) {
+			_ERROR("(%s-%d) save VL53L0X calibration data failed\n",
+					__func__, __LINE__);
+		}
+	}
+
+	return Status;
+}
+
+/**
+ * apply the saved result of reference SPAD management and reference calibration
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		error message, VL53L0X_ERROR_UNDEFINED if there is no saved result
+ *
+ */
+VL53L0X_Error loadRefCalibration() {
+
+	VL53L0X_Error Status = VL53L0X_ERROR_NONE;
+	VL53L0X_Dev_t *pDevice = &vl53l0xDevice;
+	VL53L0X_CALIBRATION_STRUCT cal;
+	unsigned long accesses = VL53L0X_GetRegisterAccessCount();
+	unsigned long transactions = VL53L0X_GetTransactionCount();
+
+	if (!parseCalibrationData(&cal)) {
+		return VL53L0X_ERROR_UNDEFINED;
+	}
+
+	_DEBUG(DEBUG_NORMAL,
+			"Apply VL53L0X calibration data: refSpadCount = %d, isApertureSpads = %d, VhvSettings = %d, PhaseCal = %d\n",
+			cal.refSpadCount, cal.isApertureSpads, cal.vhvSettings,
+			cal.phaseCal);
+
+	Status = VL53L0X_SetReferenceSpads(pDevice, cal.refSpadCount,
+			cal.isApertureSpads);
+
+	if (Status == VL53L0X_ERROR_NONE) {
+		Status = VL53L0X_SetRefCalibration(pDevice, cal.vhvSettings,
+				cal.phaseCal);
+	}
+
+	print_pal_error(Status);
+
+	printI2cTransactions("saved calibration", accesses, transactions);
+
+	return Status;
+}
+
+/**
+ * parse VL53L0X calibration data
+ *
+ * @param cal
+ * 		calibration data
+ *
+ * @return bool
+ *		parse calibration data successfully or not
+ *
+ */
+bool parseCalibrationData(VL53L0X_CALIBRATION_STRUCT *cal) {
+
+	char buf[256];
+	FILE *fptr;
+	cJSON *pJsonRoot;
+	cJSON *pSubRefSpadCount;
+	cJSON *pSubIsApertureSpads;
+	cJSON *pSubVhvSettings;
+	cJSON *pSubPhaseCal;
+	bool ret = false;
+
+	fptr = fopen(VL53L0X_CAL_DATA_PATH, "r");
+	if (NULL == fptr) {
+		_DEBUG(DEBUG_NORMAL, "Vl53l0xCal.data doesn't exist\n");
+		return false;
+	}
+
+	memset(buf, '\0', sizeof(buf));
+	fread(buf, 1, sizeof(buf) - 1, fptr);
+	fclose(fptr);
+
+	pJsonRoot = cJSON_Parse(buf);
+	if (NULL == pJsonRoot) {
+		return false;
+	}
+
+	pSubRefSpadCount = cJSON_GetObjectItem(pJsonRoot, "Ref Spad Count");
+	pSubIsApertureSpads = cJSON_GetObjectItem(pJsonRoot, "Is Aperture Spads");
+	pSubVhvSettings = cJSON_GetObjectItem(pJsonRoot, "Vhv Settings");
+	pSubPhaseCal = cJSON_GetObjectItem(pJsonRoot, "Phase Cal");
+
+	if (NULL != pSubRefSpadCount && NULL != pSubIsApertureSpads
+			&& NULL != pSubVhvSettings && NULL != pSubPhaseCal) {
+
+		cal->refSpadCount = pSubRefSpadCount->valueint;
+		cal->isApertureSpads = pSubIsApertureSpads->valueint;
+		cal->vhvSettings = pSubVhvSettings->valueint;
+		cal->phaseCal = pSubPhaseCal->valueint;
+		ret = true;
+	}
+
+	cJSON_Delete(pJsonRoot);
+
+	return ret;
+}
+
+/**
+ * save VL53L0X calibration data
+ *
+ * @param cal
+ * 		calibration data
+ *
+ * @return bool
+ *		save calibration data successfully or not
+ *
+ */
+bool saveCalibrationData(VL53L0X_CALIBRATION_STRUCT *cal) {
+
+	cJSON *pJsonRoot = NULL;
+	char *p;
+	FILE *fptr;
+
+	pJsonRoot = cJSON_CreateObject();
+	if (NULL == pJsonRoot) {
+		return false;
+	}
+
+	cJSON_AddNumberToObject(pJsonRoot, "Ref Spad Count", cal->refSpadCount);
+	cJSON_AddNumberToObject(pJsonRoot, "Is Aperture Spads",
+			cal->isApertureSpads);
+	cJSON_AddNumberToObject(pJsonRoot, "Vhv Settings", cal->vhvSettings);
+	cJSON_AddNumberToObject(pJsonRoot, "Phase Cal", cal->phaseCal);
+
+	p = cJSON_Print(pJsonRoot);
+	cJSON_Delete(pJsonRoot);
+	if (NULL == p) {
+		return false;
+	}
+
+	fptr = fopen(VL53L0X_CAL_DATA_PATH, "w");
+	if (NULL == fptr) {
+		free(p);
+		return false;
+	}
+
+	fwrite(p, strlen(p), 1, fptr);
+	fclose(fptr);
+	free(p);
+
+	return true;
+}
+
+#ifdef VL53L0X_GPIO1_INTERRUPT
+/**
+ * init data ready interrupt, vl53l0x pulls GPIO1 low when a measurement is ready
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		bool
+ *
+ */
+bool dataReadyInterruptInit() {
+
+	if (sem_init(&dataReadySem, 0, 0) != 0) {
+		_ERROR("(%s-%d) sem_init failed\n", __func__, __LINE__);
+		return false;
+	}
+
+	if (wiringPiISR(VL53L0X_GPIO1_PIN, INT_EDGE_FALLING, &dataReadyIsr) < 0) {
+		_ERROR("(%s-%d) wiringPiISR failed\n", __func__, __LINE__);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * ISR of vl53l0x GPIO1 pin
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		void
+ *
+ */
+void dataReadyIsr(void) {
+	sem_post(&dataReadySem);
+}
+#endif
+
 /**
  * print error message
  *
@@ -254,27 +676,222 @@ void print_pal_error(VL53L0X_Error Status) {
 }
 
 /**
- * get measurement data from vl53l0x
+ * print register accesses and I2C transactions of a VL53L0X API call
  *
- * @param
- * 		data
+ * @param name
+ * 		name of API call
+ *
+ * @param accesses
+ * 		register access count before the call
+ *
+ * @param transactions
+ * 		transaction count before the call
  *
  * @return
- *		bool
+ *		void
+ *
+ */
+void printI2cTransactions(char *name, unsigned long accesses,
+		unsigned long transactions) {
+
+	_DEBUG(DEBUG_NORMAL, "%s: %ld register accesses in %ld I2C transactions\n",
+			name, VL53L0X_GetRegisterAccessCount() - accesses,
+			VL53L0X_GetTransactionCount() - transactions);
+}
+
+/**
+ * collect a measurement of continuous ranging, it never waits for a measurement:
+ * completion is signalled by GPIO1 interrupt or found by polling the status register,
+ * the status register is also checked when no interrupt arrives for 2 timing budgets,
+ * so a missed edge doesn't stop ranging, a pending timing budget is applied right after
+ * a measurement is collected
+ *
+ * @param cm
+ * 		distance
+ *
+ * @return
+ *		true if a new distance is collected
  *
  */
 bool vl53l0xGetMeasurementData(unsigned short *cm) {
 
 	VL53L0X_Error Status = VL53L0X_ERROR_NONE;
 	VL53L0X_RangingMeasurementData_t RangingMeasurementData;
-
 	VL53L0X_Dev_t *pDevice = &vl53l0xDevice;
+	struct timeval tv;
+	unsigned long budget = 0;
+	uint8_t isReady = 0;
 
-	Status = VL53L0X_PerformSingleRangingMeasurement(pDevice,
+#ifdef VL53L0X_GPIO1_INTERRUPT
+	gettimeofday(&tv, NULL);
+	if (sem_trywait(&dataReadySem) != 0) {
+
+		if (GET_USEC_TIMEDIFF(tv, dataReady_tv) < 2 * timingBudget) {
+			return false;
+		}
+
+		// GPIO1 stays low if an edge is missed, it is released by clearing the interrupt
+		UPDATE_LAST_TIME(tv, dataReady_tv);
+		Status = VL53L0X_GetMeasurementDataReady(pDevice, &isReady);
+		if (Status != VL53L0X_ERROR_NONE || !isReady) {
+			return false;
+		}
+		_DEBUG(DEBUG_NORMAL, "VL53L0X: data ready interrupt is missed\n");
+	}
+	UPDATE_LAST_TIME(tv, dataReady_tv);
+#else
+	Status = VL53L0X_GetMeasurementDataReady(pDevice, &isReady);
+	if (Status != VL53L0X_ERROR_NONE || !isReady) {
+		return false;
+	}
+#endif
+
+	Status = VL53L0X_GetRangingMeasurementData(pDevice,
 			&RangingMeasurementData);
+	VL53L0X_ClearInterruptMask(pDevice,
+			VL53L0X_REG_SYSTEM_INTERRUPT_GPIO_NEW_SAMPLE_READY);
+
+	budget = __atomic_exchange_n(&pendingTimingBudget, 0, __ATOMIC_RELAXED);
+	if (budget) {
+		applyTimingBudget(budget);
+	}
+
+	if (__atomic_exchange_n(&calibrationIsRequested, false, __ATOMIC_RELAXED)) {
+		stopRanging();
+		if (performRefCalibration() != VL53L0X_ERROR_NONE) {
+			_ERROR("(%s-%d) VL53L0X recalibration failed\n", __func__,
+					__LINE__);
+		}
+		restartRanging();
+	}
 
-	*cm =(unsigned short)kalmanFilterOneDimCalc((float)RangingMeasurementData.RangeMilliMeter*0.1f ,&vl53l0KalmanFilterEntry);
+	VL53L0X_FlushWrites(pDevice);
 
-	return ((Status == VL53L0X_ERROR_NONE) ? true : false);
+	if (Status != VL53L0X_ERROR_NONE) {
+		return false;
+	}
+
+	gettimeofday(&tv, NULL);
+	rangingCount++;
+	maxInterval = max(maxInterval, GET_USEC_TIMEDIFF(tv, lastSample_tv));
+	UPDATE_LAST_TIME(tv, lastSample_tv);
+
+	*cm =(unsigned short)filterUpdate(&vl53l0KalmanFilterEntry, (float)RangingMeasurementData.RangeMilliMeter*0.1f);
+
+	return true;
+}
+
+/**
+ * request a new timing budget, longer budget is more accurate and shorter budget is faster,
+ * it is applied between two measurements by vl53l0xGetMeasurementData
+ *
+ * @param budget
+ * 		timing budget (us)
+ *
+ * @return
+ *		bool
+ *
+ */
+bool vl53l0xSetTimingBudget(unsigned long budget) {
+
+	if (budget < VL53L0X_MIN_TIMING_BUDGET
+			|| budget > VL53L0X_MAX_TIMING_BUDGET) {
+		_ERROR("(%s-%d) invalid timing budget %ld us\n", __func__, __LINE__,
+				budget);
+		return false;
+	}
+
+	__atomic_store_n(&pendingTimingBudget, budget, __ATOMIC_RELAXED);
+
+	return true;
+}
+
+/**
+ * request to run reference SPAD management and reference calibration again and save the result,
+ * it is run between two measurements by vl53l0xGetMeasurementData
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		void
+ *
+ */
+void vl53l0xRequestCalibration() {
+	__atomic_store_n(&calibrationIsRequested, true, __ATOMIC_RELAXED);
 }
 
+/**
+ * drop the calibration which is requested but not run yet
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		true if a request is dropped
+ *
+ */
+bool vl53l0xCancelCalibration() {
+	return __atomic_exchange_n(&calibrationIsRequested, false, __ATOMIC_RELAXED);
+}
+
+/**
+ * get timing budget
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		timing budget (us)
+ *
+ */
+unsigned long vl53l0xGetTimingBudget() {
+	return timingBudget;
+}
+
+/**
+ * get the period to call vl53l0xGetMeasurementData
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		period (us)
+ *
+ */
+unsigned long vl53l0xGetUpdatePeriod() {
+	return VL53L0X_POLL_PERIOD;
+}
+
+/**
+ * print achieved ranging rate, the longest interval between two measurements and the bus traffic since last call
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		void
+ *
+ */
+void vl53l0xPrintStatistics() {
+
+	struct timeval tv;
+	float elapsed = 0.f;
+
+	gettimeofday(&tv, NULL);
+	elapsed = GET_SEC_TIMEDIFF(tv, statisticsStart_tv);
+
+	_DEBUG_HOVER(DEBUG_HOVER_STATISTICS,
+			"VL53L0X: timing budget=%ld us, rate=%.2f Hz, max interval=%ld us, %ld register accesses in %ld I2C transactions\n",
+			timingBudget,
+			(elapsed > 0.f) ? (float) rangingCount / elapsed : 0.f,
+			maxInterval,
+			VL53L0X_GetRegisterAccessCount() - statisticsAccesses,
+			VL53L0X_GetTransactionCount() - statisticsTransactions);
+
+	UPDATE_LAST_TIME(tv, statisticsStart_tv);
+	rangingCount = 0;
+	maxInterval = 0;
+	statisticsAccesses = VL53L0X_GetRegisterAccessCount();
+	statisticsTransactions = VL53L0X_GetTransactionCount();
+}
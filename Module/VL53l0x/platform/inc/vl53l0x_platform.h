@@ -228,6 +228,27 @@ VL53L0X_Error VL53L0X_UpdateByte(VL53L0X_DEV Dev, uint8_t index, uint8_t AndData
  */
 VL53L0X_Error VL53L0X_PollingDelay(VL53L0X_DEV Dev); /* usually best implemented as a real function */
 
+/**
+ * @brief Send the register writes which are queued by the platform
+ *
+ * Register writes are queued and sent together with the next read, call it when no read follows
+ *
+ * @param Dev       Device Handle
+ * @return  VL53L0X_ERROR_NONE        Success
+ * @return  "Other error code"    See ::VL53L0X_Error
+ */
+VL53L0X_Error VL53L0X_FlushWrites(VL53L0X_DEV Dev);
+
+/**
+ * @brief Number of register reads and writes requested by the API
+ */
+unsigned long VL53L0X_GetRegisterAccessCount(void);
+
+/**
+ * @brief Number of I2C transactions issued for the requested register accesses
+ */
+unsigned long VL53L0X_GetTransactionCount(void);
+
 /** @} end of VL53L0X_platform_group */
 
 #ifdef __cplusplus
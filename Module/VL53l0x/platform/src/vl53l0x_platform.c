@@ -22,26 +22,73 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 ******************************************************************************/
 
+#include <string.h>
 #include <unistd.h>
 #include "commonLib.h"
 #include "i2c.h"
 #include "vl53l0x_platform.h"
 #include "vl53l0x_api.h"
 
-VL53L0X_Error VL53L0X_LockSequenceAccess(VL53L0X_DEV Dev) {
-	VL53L0X_Error Status = VL53L0X_ERROR_NONE;
-	return Status;
-}
+#define WRITE_QUEUE_MAX (I2C_WRITE_BATCH_MAX - 2) // 2 messages are left for the read which flushes the queue
+
+/**
+ * register writes are queued and sent in one I2C_RDWR ioctl together with the next read,
+ * or when the queue is full, or before a polling delay, or by VL53L0X_FlushWrites,
+ * so the device sees the same register sequence in the same order with far fewer transactions.
+ * an error of a queued write is returned by the call which flushes it
+ */
+static I2C_WRITE_REQUEST_STRUCT writeQueue[WRITE_QUEUE_MAX];
+static uint8_t writeQueueData[I2C_WRITE_BATCH_BUF_SIZE];
+static unsigned char queuedWrites = 0;
+static unsigned short queuedBytes = 0; // register address and data of every queued write
+static unsigned long registerAccesses = 0;
+static unsigned long transactions = 0;
+
+static VL53L0X_Error flushWritesThenRead(VL53L0X_DEV Dev, uint8_t index,
+		uint8_t *pdata, uint32_t count);
+static VL53L0X_Error queueWrite(VL53L0X_DEV Dev, uint8_t index, uint8_t *pdata,
+		uint32_t count);
+
+/**
+ * send queued writes and then read a register block in the same transaction
+ *
+ * @param Dev
+ * 		device handle
+ *
+ * @param index
+ * 		register to read
+ *
+ * @param pdata
+ * 		destination, or NULL to send queued writes only
+ *
+ * @param count
+ * 		number of bytes to read
+ *
+ * @return
+ *		error code
+ *
+ */
+static VL53L0X_Error flushWritesThenRead(VL53L0X_DEV Dev, uint8_t index,
+		uint8_t *pdata, uint32_t count) {
+
+	I2C_READ_REQUEST_STRUCT read;
+	bool ret = true;
+
+	if (NULL == pdata && 0 == queuedWrites) {
+		return VL53L0X_ERROR_NONE;
+	}
 
-VL53L0X_Error VL53L0X_UnlockSequenceAccess(VL53L0X_DEV Dev) {
-	VL53L0X_Error Status = VL53L0X_ERROR_NONE;
-	return Status;
-}
+	read.devAddr = Dev->I2cDevAddr;
+	read.regAddr = index;
+	read.length = count;
+	read.data = pdata;
 
-VL53L0X_Error VL53L0X_WriteMulti(VL53L0X_DEV Dev, uint8_t index, uint8_t *pdata,
-		uint32_t count) {
+	transactions++;
+	ret = writeBytesBatchThenRead(writeQueue, queuedWrites,
+			(NULL == pdata) ? NULL : &read);
 
-	bool ret = writeBytes(Dev->I2cDevAddr, index, count, pdata);
+	queuedWrites = 0;
+	queuedBytes = 0;
 
 	if (!ret) {
 		return VL53L0X_ERROR_CONTROL_INTERFACE;
@@ -50,96 +97,142 @@ VL53L0X_Error VL53L0X_WriteMulti(VL53L0X_DEV Dev, uint8_t index, uint8_t *pdata,
 	return VL53L0X_ERROR_NONE;
 }
 
-VL53L0X_Error VL53L0X_ReadMulti(VL53L0X_DEV Dev, uint8_t index, uint8_t *pdata,
+/**
+ * queue a register write, the queue is flushed first if it is full
+ *
+ * @param Dev
+ * 		device handle
+ *
+ * @param index
+ * 		register to write
+ *
+ * @param pdata
+ * 		data
+ *
+ * @param count
+ * 		number of bytes
+ *
+ * @return
+ *		error code
+ *
+ */
+static VL53L0X_Error queueWrite(VL53L0X_DEV Dev, uint8_t index, uint8_t *pdata,
 		uint32_t count) {
 
-	int ret = readBytes(Dev->I2cDevAddr, index, count, pdata);
+	VL53L0X_Error Status = VL53L0X_ERROR_NONE;
 
-	if (ret < 0) {
-		return VL53L0X_ERROR_CONTROL_INTERFACE;
-	}
+	registerAccesses++;
 
-	return VL53L0X_ERROR_NONE;
-}
+	// too large to be queued, keep the order by flushing the queue first
+	if (count + 1 > sizeof(writeQueueData)) {
 
-VL53L0X_Error VL53L0X_WrByte(VL53L0X_DEV Dev, uint8_t index, uint8_t data) {
+		Status = flushWritesThenRead(Dev, 0, NULL, 0);
+		if (Status != VL53L0X_ERROR_NONE) {
+			return Status;
+		}
 
-	bool ret = writeByte(Dev->I2cDevAddr, index, data);
+		transactions++;
+		if (!writeBytes(Dev->I2cDevAddr, index, count, pdata)) {
+			return VL53L0X_ERROR_CONTROL_INTERFACE;
+		}
 
-	if (!ret) {
-		return VL53L0X_ERROR_CONTROL_INTERFACE;
+		return VL53L0X_ERROR_NONE;
 	}
 
+	if (queuedWrites >= WRITE_QUEUE_MAX
+			|| queuedBytes + count + 1 > sizeof(writeQueueData)) {
+		Status = flushWritesThenRead(Dev, 0, NULL, 0);
+		if (Status != VL53L0X_ERROR_NONE) {
+			return Status;
+		}
+	}
+
+	memcpy(writeQueueData + queuedBytes, pdata, count);
+	writeQueue[queuedWrites].devAddr = Dev->I2cDevAddr;
+	writeQueue[queuedWrites].regAddr = index;
+	writeQueue[queuedWrites].length = count;
+	writeQueue[queuedWrites].data = writeQueueData + queuedBytes;
+	queuedWrites++;
+	queuedBytes += count + 1;
+
 	return VL53L0X_ERROR_NONE;
 }
 
-VL53L0X_Error VL53L0X_WrWord(VL53L0X_DEV Dev, uint8_t index, uint16_t data) {
+VL53L0X_Error VL53L0X_LockSequenceAccess(VL53L0X_DEV Dev) {
+	VL53L0X_Error Status = VL53L0X_ERROR_NONE;
+	return Status;
+}
 
-	bool ret = writeWord(Dev->I2cDevAddr, index, data);
+VL53L0X_Error VL53L0X_UnlockSequenceAccess(VL53L0X_DEV Dev) {
+	VL53L0X_Error Status = VL53L0X_ERROR_NONE;
+	return Status;
+}
 
-	if (!ret) {
-		return VL53L0X_ERROR_CONTROL_INTERFACE;
-	}
+VL53L0X_Error VL53L0X_WriteMulti(VL53L0X_DEV Dev, uint8_t index, uint8_t *pdata,
+		uint32_t count) {
+	return queueWrite(Dev, index, pdata, count);
+}
 
-	return VL53L0X_ERROR_NONE;
+VL53L0X_Error VL53L0X_ReadMulti(VL53L0X_DEV Dev, uint8_t index, uint8_t *pdata,
+		uint32_t count) {
 
+	registerAccesses++;
+
+	return flushWritesThenRead(Dev, index, pdata, count);
 }
 
-VL53L0X_Error VL53L0X_WrDWord(VL53L0X_DEV Dev, uint8_t index, uint32_t data) {
+VL53L0X_Error VL53L0X_WrByte(VL53L0X_DEV Dev, uint8_t index, uint8_t data) {
+	return queueWrite(Dev, index, &data, 1);
+}
 
-	uint16_t pData[2];
-	bool ret;
+VL53L0X_Error VL53L0X_WrWord(VL53L0X_DEV Dev, uint8_t index, uint16_t data) {
 
-	pData[0] = (uint16_t) (data & 0x0000FFFF);
-	pData[1] = (uint16_t) ((data & 0xFFFF0000) >> 16);
+	uint8_t buf[2];
 
-	ret = writeWords(Dev->I2cDevAddr, index, 2, pData);
+	buf[0] = (uint8_t) (data >> 8);
+	buf[1] = (uint8_t) data;
 
-	if (!ret) {
-		return VL53L0X_ERROR_CONTROL_INTERFACE;
-	}
+	return queueWrite(Dev, index, buf, 2);
+}
 
-	return VL53L0X_ERROR_NONE;
+VL53L0X_Error VL53L0X_WrDWord(VL53L0X_DEV Dev, uint8_t index, uint32_t data) {
+
+	uint8_t buf[4];
 
+	buf[0] = (uint8_t) (data >> 24);
+	buf[1] = (uint8_t) (data >> 16);
+	buf[2] = (uint8_t) (data >> 8);
+	buf[3] = (uint8_t) data;
+
+	return queueWrite(Dev, index, buf, 4);
 }
 
 VL53L0X_Error VL53L0X_UpdateByte(VL53L0X_DEV Dev, uint8_t index,
 		uint8_t AndData, uint8_t OrData) {
 
+	VL53L0X_Error Status = VL53L0X_ERROR_NONE;
 	uint8_t data;
-	int ret = readByte(Dev->I2cDevAddr, index, &data);
 
-	if (ret < 0) {
-		return VL53L0X_ERROR_CONTROL_INTERFACE;
-	}
-
-	data = (data & AndData) | OrData;
+	// the read goes with the queued writes and the write is queued for the next transaction
+	Status = VL53L0X_RdByte(Dev, index, &data);
 
-	ret = writeByte(Dev->I2cDevAddr, index, data);
-
-	if (!ret) {
-		return VL53L0X_ERROR_CONTROL_INTERFACE;
+	if (Status != VL53L0X_ERROR_NONE) {
+		return Status;
 	}
 
-	return VL53L0X_ERROR_NONE;
+	data = (data & AndData) | OrData;
 
+	return VL53L0X_WrByte(Dev, index, data);
 }
 
 VL53L0X_Error VL53L0X_RdByte(VL53L0X_DEV Dev, uint8_t index, uint8_t *data) {
-
-	int ret = readByte(Dev->I2cDevAddr, index, data);
-
-	if (ret < 0) {
-		return VL53L0X_ERROR_CONTROL_INTERFACE;
-	}
-
-	return VL53L0X_ERROR_NONE;
+	return VL53L0X_ReadMulti(Dev, index, data, 1);
 }
 
 VL53L0X_Error VL53L0X_RdWord(VL53L0X_DEV Dev, uint8_t index, uint16_t *data) {
 
 	uint8_t buf[2];
-	int ret = readBytes(Dev->I2cDevAddr, index, 2, buf);
+	VL53L0X_Error Status = VL53L0X_ReadMulti(Dev, index, buf, 2);
 	uint16_t tmp = 0;
 
 	tmp |= buf[1] << 0;
@@ -147,16 +240,12 @@ VL53L0X_Error VL53L0X_RdWord(VL53L0X_DEV Dev, uint8_t index, uint16_t *data) {
 
 	*data = tmp;
 
-	if (ret < 0) {
-		return VL53L0X_ERROR_CONTROL_INTERFACE;
-	}
-
-	return VL53L0X_ERROR_NONE;
+	return Status;
 }
 
 VL53L0X_Error VL53L0X_RdDWord(VL53L0X_DEV Dev, uint8_t index, uint32_t *data) {
 	uint8_t buf[4];
-	int ret = readBytes(Dev->I2cDevAddr, index, 4, buf);
+	VL53L0X_Error Status = VL53L0X_ReadMulti(Dev, index, buf, 4);
 	uint32_t tmp = 0;
 
 	tmp |= buf[3] << 0;
@@ -165,16 +254,26 @@ VL53L0X_Error VL53L0X_RdDWord(VL53L0X_DEV Dev, uint8_t index, uint32_t *data) {
 	tmp |= buf[0] << 24;
 	*data = tmp;
 
-	if (ret < 0) {
-		return VL53L0X_ERROR_CONTROL_INTERFACE;
-	}
-
-	return VL53L0X_ERROR_NONE;
+	return Status;
 }
 
 VL53L0X_Error VL53L0X_PollingDelay(VL53L0X_DEV Dev) {
 
+	VL53L0X_Error Status = VL53L0X_FlushWrites(Dev);
+
 	usleep(5000);
 
-	return VL53L0X_ERROR_NONE;
+	return Status;
+}
+
+VL53L0X_Error VL53L0X_FlushWrites(VL53L0X_DEV Dev) {
+	return flushWritesThenRead(Dev, 0, NULL, 0);
+}
+
+unsigned long VL53L0X_GetRegisterAccessCount() {
+	return registerAccesses;
+}
+
+unsigned long VL53L0X_GetTransactionCount() {
+	return transactions;
 }
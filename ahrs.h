@@ -23,9 +23,9 @@ SOFTWARE.
 ******************************************************************************/
 
 void IMUupdate6(float gx, float gy, float gz, float ax, float ay, float az,
-		float q[]);
+		float timeDiff, float q[]);
 void IMUupdate9(float gx, float gy, float gz, float ax, float ay, float az, float mx, float my, float mz,
-		float q[]);
+		float timeDiff, float q[]);
 float invSqrt(float x);
 void ahrsInit();
 
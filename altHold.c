@@ -26,6 +26,7 @@ SOFTWARE.
 #include <stdlib.h>
 #include <unistd.h>
 #include <math.h>
+#include <time.h>
 #include <sys/time.h>
 #include <pthread.h>
 #include "commonLib.h"
@@ -33,6 +34,10 @@ SOFTWARE.
 #include "pid.h"
 #include "motorControl.h"
 #include "attitudeUpdate.h"
+#include "systemControl.h"
+#include "periodicTask.h"
+#include "altitudeEstimator.h"
+#include "altitudeSample.h"
 #if defined(ALTHOLD_MODULE_MS5611)
 #include "ms5611.h"
 #elif defined(ALTHOLD_MODULE_SRF02)
@@ -42,17 +47,32 @@ SOFTWARE.
 #endif
 #include "altHold.h"
 
-#define ALTHOLD_UPDATE_PERIOD 100000
+#define CENTI_G_TO_CM_S2 9.80665f // vertical acceleration of attitudeUpdate is in 0.01 g
+#define ALTHOLD_ACCEL_NOISE 2500.f // (cm/s^2)^2
+#define ALTHOLD_MAX_PREDICT_DT 0.1f // s
+#if defined(ALTHOLD_MODULE_MS5611)
+#define ALTHOLD_SAMPLE_PERIOD ms5611GetUpdatePeriod() // us, one conversion per period
+#define ALTHOLD_MEASUREMENT_NOISE 400.f // cm^2
+#define ALTHOLD_MAX_SAMPLE_AGE (3 * ALTHOLD_SAMPLE_PERIOD) // us
+#elif defined(ALTHOLD_MODULE_SRF02)
+#define ALTHOLD_SAMPLE_PERIOD srf02GetUpdatePeriod() // us, ranging is polled
+#define ALTHOLD_MEASUREMENT_NOISE 25.f // cm^2
+#define ALTHOLD_MAX_SAMPLE_AGE (srf02GetMaxLatency() + 3 * ALTHOLD_SAMPLE_PERIOD) // us, a range describes its ping
+#else
+#define ALTHOLD_SAMPLE_PERIOD vl53l0xGetUpdatePeriod() // us, continuous ranging is polled
+#define ALTHOLD_MEASUREMENT_NOISE 9.f // cm^2
+#define ALTHOLD_MAX_SAMPLE_AGE (vl53l0xGetTimingBudget() + 3 * ALTHOLD_SAMPLE_PERIOD) // us, a range spans its timing budget
+#endif
+#define ALTHOLD_STATISTICS_PERIOD 5000000 // us
 
-static float aslRaw = 0.f;
 static float targetAlt = 0;
-static float altholdSpeed = 0;
+static ALTITUDE_ESTIMATOR_STRUCT altitudeEstimator;
+static ALTITUDE_SAMPLE_STRUCT lastAltitudeSample;
+static unsigned long altHoldSampleAge = 0; // us
 static bool altHoldIsReady = false;
 static bool enableAltHold = false;
-static bool altholdIsUpdate = false;
 static unsigned int maxAlt = 50; 		//cm
 static pthread_t altHoldThreadId;
-static pthread_mutex_t altHoldIsUpdateMutex;
 
 static void setAltHoldIsReady(bool v);
 static void setMaxAlt(unsigned int v);
@@ -103,11 +123,8 @@ bool initAltHold() {
 	return false;
 #endif
 
-	if (pthread_mutex_init(&altHoldIsUpdateMutex, NULL) != 0) {
-		_ERROR("(%s-%d) altHoldIsUpdateMutex init failed\n", __func__,
-				__LINE__);
-		return false;
-	}
+	initAltitudeEstimator(&altitudeEstimator, ALTHOLD_ACCEL_NOISE,
+			ALTHOLD_MEASUREMENT_NOISE);
 
 	if (pthread_create(&altHoldThreadId, NULL, altHoldUpdate, 0)) {
 		_DEBUG(DEBUG_NORMAL, "altHold thread create failed\n");
@@ -212,37 +229,119 @@ unsigned int getMaxAlt() {
  * 		void
  *
  * @return
- *		altitude (cm)
+ *		estimated altitude (cm)
  *
  */
 float getCurrentAltHoldAltitude() {
-	return aslRaw;
+	return altitudeEstimator.altitude;
 }
 
 /**
- *  check whether update AltHold info or not
+ * update altitude and vertical speed estimation, it is called in every control cycle:
+ * vertical acceleration predicts the state and the measurement of althold sensor corrects it when it arrives
  *
  * @param
  * 		void
  *
  * @return
- *		true or false
+ *		void
  *
  */
-bool updateAltHold() {
+void updateAltitudeEstimate() {
 
-	bool ret = false;
+	static struct timeval last_tv;
+	struct timeval tv;
+	float dt = 0.f;
+	bool isUpdated = false;
 
-	pthread_mutex_lock(&altHoldIsUpdateMutex);
-	if (altholdIsUpdate) {
-		altholdIsUpdate = false;
-		ret = true;
-	} else {
-		ret = false;
+	gettimeofday(&tv, NULL);
+	if (TIME_IS_UPDATED(last_tv)) {
+		dt = LIMIT_MIN_MAX_VALUE(GET_SEC_TIMEDIFF(tv, last_tv), 0.f,
+				ALTHOLD_MAX_PREDICT_DT);
+	}
+	UPDATE_LAST_TIME(tv, last_tv);
+
+	altitudeEstimatorPredict(&altitudeEstimator, dt,
+			getVerticalAcceleration() * CENTI_G_TO_CM_S2);
+
+	isUpdated = consumeAltitudeSample(&lastAltitudeSample);
+	if (lastAltitudeSample.seq) {
+		altHoldSampleAge = getAltitudeSampleAge(&lastAltitudeSample);
+	}
+
+	if (isUpdated && altHoldSampleAge <= ALTHOLD_MAX_SAMPLE_AGE) {
+		// the sample is measured altHoldSampleAge ago, move it to now by the estimated speed
+		altitudeEstimatorCorrect(&altitudeEstimator,
+				lastAltitudeSample.altitude
+						+ altitudeEstimator.velocity
+								* ((float) altHoldSampleAge / 1000000.f));
+	}
+
+	_DEBUG_HOVER(DEBUG_HOVER_SPEED, "(%s-%d) altitude=%.3f speed=%.3f\n",
+			__func__, __LINE__, altitudeEstimator.altitude,
+			altitudeEstimator.velocity);
+}
+
+/**
+ * get age of the newest althold sensor sample
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		time since the newest sample is measured (us)
+ *
+ */
+unsigned long getAltHoldSampleAge() {
+	return altHoldSampleAge;
+}
+
+/**
+ * request the althold sensor to run its calibration again, it is run in althold thread
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		false if the sensor doesn't support calibration
+ *
+ */
+bool requestAltHoldSensorCalibration() {
+
+#if defined(ALTHOLD_MODULE_VL53L0X)
+	if (!getAltHoldIsReady()) {
+		return false;
 	}
-	pthread_mutex_unlock(&altHoldIsUpdateMutex);
 
-	return ret;
+	vl53l0xRequestCalibration();
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+/**
+ * request a new timing budget of the althold sensor, it is applied in althold thread
+ *
+ * @param budget
+ * 		timing budget (us)
+ *
+ * @return
+ *		false if the sensor doesn't support it or the budget is out of range
+ *
+ */
+bool setAltHoldSensorTimingBudget(unsigned long budget) {
+
+#if defined(ALTHOLD_MODULE_VL53L0X)
+	if (!getAltHoldIsReady()) {
+		return false;
+	}
+
+	return vl53l0xSetTimingBudget(budget);
+#else
+	return false;
+#endif
 }
 
 /**
@@ -266,11 +365,11 @@ float getTargetAlt(){
  * 		void
  *
  * @return
- *		altitude speed
+ *		estimated vertical speed (cm/s)
  *
  */
 float getAltholdSpeed(){
-	return altholdSpeed;
+	return altitudeEstimator.velocity;
 }
 
 
@@ -321,61 +420,62 @@ void updateTargetAltitude(float throttle){
 void *altHoldUpdate(void *arg) {
 
 	unsigned short data = 0;
-	unsigned long interval=0;
 	bool result = false;
+	PERIODIC_TASK_STRUCT altHoldTask;
 	struct timeval tv;
-	struct timeval tv2;
+	struct timeval sample_tv;
+	struct timeval statistics_tv;
+
+	setupNonRealTimeThread();
+	periodicTaskInit(&altHoldTask, "altHold", ALTHOLD_SAMPLE_PERIOD,
+			PERIODIC_TASK_SKIP);
+	gettimeofday(&statistics_tv, NULL);
 
 	while (!getLeaveFlyControlerFlag()&&getAltHoldIsReady()) {
 
-		gettimeofday(&tv,NULL);
-	
-		if(TIME_IS_UPDATED(tv2)){
+		periodicTaskSetPeriod(&altHoldTask, ALTHOLD_SAMPLE_PERIOD);
 
 #if defined(ALTHOLD_MODULE_MS5611)
-			result = ms5611GetMeasurementData(&data);
+		result = ms5611GetMeasurementData(&data);
 #elif defined(ALTHOLD_MODULE_SRF02)
-			result = srf02GetMeasurementData(&data);
+		result = srf02GetMeasurementData(&data);
 #elif defined(ALTHOLD_MODULE_VL53L0X)
-			result = vl53l0xGetMeasurementData(&data);
+		// calibration stops ranging, it may not start once the fly system is enabled
+		if (flySystemIsEnable() && vl53l0xCancelCalibration()) {
+			_DEBUG(DEBUG_NORMAL, "Althold sensor calibration is dropped, fly system is enabled\n");
+		}
+		result = vl53l0xGetMeasurementData(&data);
 #else
-			result = false;
+		result = false;
 #endif
 
-			if (result && data <= getMaxAlt()) {
-					
-				interval = GET_USEC_TIMEDIFF(tv,tv2);			
-							
-				//_DEBUG(DEBUG_NORMAL,"duration=%ld us\n",interval);	
-						
-				altholdSpeed = getVerticalAcceleration();
-				aslRaw=(float)data;
-				
-				if(interval>=ALTHOLD_UPDATE_PERIOD){
-					
-					pthread_mutex_lock(&altHoldIsUpdateMutex);
-					altholdIsUpdate = true;
-					pthread_mutex_unlock(&altHoldIsUpdateMutex);
-					UPDATE_LAST_TIME(tv,tv2);
-					
-				}
-
-				_DEBUG_HOVER(DEBUG_HOVER_RAW_ALTITUDE, "(%s-%d) aslRaw=%.3f\n",
-						__func__, __LINE__, aslRaw);
-				_DEBUG_HOVER(DEBUG_HOVER_SPEED, "(%s-%d) altholdSpeed=%.3f\n",
-						__func__, __LINE__, altholdSpeed);
-			
-			} else {
-					usleep(5000);
-			}
-			
-		}else{
-			UPDATE_LAST_TIME(tv,tv2);
+		if (result && data <= getMaxAlt()) {
+
+#if defined(ALTHOLD_MODULE_SRF02)
+			srf02GetMeasurementTv(&sample_tv);
+#else
+			gettimeofday(&sample_tv, NULL);
+#endif
+			publishAltitudeSample((float) data, &sample_tv);
+
+			_DEBUG_HOVER(DEBUG_HOVER_RAW_ALTITUDE, "(%s-%d) altitude=%.3f\n",
+					__func__, __LINE__, (float) data);
 		}
+
+		gettimeofday(&tv, NULL);
+		if (GET_USEC_TIMEDIFF(tv, statistics_tv) >= ALTHOLD_STATISTICS_PERIOD) {
+#if defined(ALTHOLD_MODULE_SRF02)
+			srf02PrintStatistics();
+#elif defined(ALTHOLD_MODULE_VL53L0X)
+			vl53l0xPrintStatistics();
+#endif
+			UPDATE_LAST_TIME(tv, statistics_tv);
+		}
+
+		periodicTaskWait(&altHoldTask);
 	}
 
 	pthread_exit((void *) 0);
 
 }
 
-
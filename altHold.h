@@ -23,9 +23,12 @@ SOFTWARE.
 ******************************************************************************/
 bool initAltHold();
 bool getAltHoldIsReady();
-bool updateAltHold();
+void updateAltitudeEstimate();
 bool getEnableAltHold();
 float getCurrentAltHoldAltitude();
+unsigned long getAltHoldSampleAge();
+bool requestAltHoldSensorCalibration();
+bool setAltHoldSensorTimingBudget(unsigned long budget);
 void setEnableAltHold(bool v);
 float getTargetAlt();
 float getAltholdSpeed();
@@ -0,0 +1,147 @@
+/******************************************************************************
+The altitudeEstimator.c in RaspberryPilot project is placed under the MIT license
+
+Copyright (c) 2016 jellyice1986 (Tung-Cheng Wu)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+******************************************************************************/
+
+#include <string.h>
+#include "commonLib.h"
+#include "altitudeEstimator.h"
+
+/**
+ * init a 2-state (altitude, vertical velocity) Kalman filter
+ *
+ * @param estimator
+ * 		estimator entity
+ *
+ * @param accelNoise
+ * 		variance of vertical acceleration (cm/s^2)^2
+ *
+ * @param measurementNoise
+ * 		variance of altitude measurement (cm^2)
+ *
+ * @return
+ *		void
+ *
+ */
+void initAltitudeEstimator(ALTITUDE_ESTIMATOR_STRUCT *estimator,
+		float accelNoise, float measurementNoise) {
+
+	memset(estimator, 0, sizeof(ALTITUDE_ESTIMATOR_STRUCT));
+	estimator->accelNoise = accelNoise;
+	estimator->measurementNoise = measurementNoise;
+	estimator->isInitialized = false;
+}
+
+/**
+ * predict altitude and velocity by vertical acceleration, it runs in every control cycle
+ *
+ * @param estimator
+ * 		estimator entity
+ *
+ * @param dt
+ * 		time since last prediction (s)
+ *
+ * @param accel
+ * 		vertical acceleration without gravity (cm/s^2)
+ *
+ * @return
+ *		void
+ *
+ */
+void altitudeEstimatorPredict(ALTITUDE_ESTIMATOR_STRUCT *estimator, float dt,
+		float accel) {
+
+	float dt2 = dt * dt;
+	float p00 = estimator->p[0][0];
+	float p01 = estimator->p[0][1];
+	float p10 = estimator->p[1][0];
+	float p11 = estimator->p[1][1];
+
+	if (!estimator->isInitialized || dt <= 0.f) {
+		return;
+	}
+
+	// x = F * x + B * a, F = [1 dt; 0 1], B = [dt^2/2; dt]
+	estimator->altitude += estimator->velocity * dt + 0.5f * accel * dt2;
+	estimator->velocity += accel * dt;
+
+	// P = F * P * F' + Q, Q = accelNoise * B * B'
+	estimator->p[0][0] = p00 + dt * (p10 + p01) + dt2 * p11
+			+ estimator->accelNoise * dt2 * dt2 * 0.25f;
+	estimator->p[0][1] = p01 + dt * p11
+			+ estimator->accelNoise * dt2 * dt * 0.5f;
+	estimator->p[1][0] = p10 + dt * p11
+			+ estimator->accelNoise * dt2 * dt * 0.5f;
+	estimator->p[1][1] = p11 + estimator->accelNoise * dt2;
+}
+
+/**
+ * correct altitude and velocity by an altitude measurement
+ *
+ * @param estimator
+ * 		estimator entity
+ *
+ * @param altitude
+ * 		measured altitude (cm)
+ *
+ * @return
+ *		void
+ *
+ */
+void altitudeEstimatorCorrect(ALTITUDE_ESTIMATOR_STRUCT *estimator,
+		float altitude) {
+
+	float p00 = estimator->p[0][0];
+	float p01 = estimator->p[0][1];
+	float p10 = estimator->p[1][0];
+	float p11 = estimator->p[1][1];
+	float innovation = 0.f;
+	float s = 0.f;
+	float k0 = 0.f;
+	float k1 = 0.f;
+
+	if (!estimator->isInitialized) {
+		estimator->altitude = altitude;
+		estimator->velocity = 0.f;
+		estimator->p[0][0] = estimator->measurementNoise;
+		estimator->p[0][1] = 0.f;
+		estimator->p[1][0] = 0.f;
+		estimator->p[1][1] = estimator->measurementNoise;
+		estimator->isInitialized = true;
+		return;
+	}
+
+	// H = [1 0]
+	innovation = altitude - estimator->altitude;
+	s = p00 + estimator->measurementNoise;
+	k0 = p00 / s;
+	k1 = p10 / s;
+
+	estimator->altitude += k0 * innovation;
+	estimator->velocity += k1 * innovation;
+
+	// P = (I - K * H) * P
+	estimator->p[0][0] = (1.f - k0) * p00;
+	estimator->p[0][1] = (1.f - k0) * p01;
+	estimator->p[1][0] = p10 - k1 * p00;
+	estimator->p[1][1] = p11 - k1 * p01;
+}
@@ -0,0 +1,39 @@
+/******************************************************************************
+The altitudeEstimator.h in RaspberryPilot project is placed under the MIT license
+
+Copyright (c) 2016 jellyice1986 (Tung-Cheng Wu)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+******************************************************************************/
+
+typedef struct {
+	float altitude; // cm
+	float velocity; // cm/s
+	float p[2][2]; // estimate covariance
+	float accelNoise; // variance of vertical acceleration (cm/s^2)^2
+	float measurementNoise; // variance of altitude measurement (cm^2)
+	bool isInitialized; // the first measurement sets the altitude
+} ALTITUDE_ESTIMATOR_STRUCT;
+
+void initAltitudeEstimator(ALTITUDE_ESTIMATOR_STRUCT *estimator,
+		float accelNoise, float measurementNoise);
+void altitudeEstimatorPredict(ALTITUDE_ESTIMATOR_STRUCT *estimator, float dt,
+		float accel);
+void altitudeEstimatorCorrect(ALTITUDE_ESTIMATOR_STRUCT *estimator,
+		float altitude);
@@ -0,0 +1,134 @@
+/******************************************************************************
+The altitudeSample.c in RaspberryPilot project is placed under the MIT license
+
+Copyright (c) 2016 jellyice1986 (Tung-Cheng Wu)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+******************************************************************************/
+
+#include <stdio.h>
+#include <sys/time.h>
+#include "commonLib.h"
+#include "altitudeSample.h"
+
+#define ALTITUDE_SAMPLE_INDEX_MASK 0x3
+#define ALTITUDE_SAMPLE_FRESH 0x4
+
+/**
+ * single-producer single-consumer triple buffer:
+ * the althold thread owns writeIndex, the control thread owns readIndex,
+ * and latestIndex holds the newest published slot plus a fresh bit.
+ * both sides only exchange slot indexes, so neither of them waits and a
+ * sample is never read while it is being written
+ */
+static ALTITUDE_SAMPLE_STRUCT altitudeSamples[3];
+static unsigned char writeIndex = 0;
+static unsigned char readIndex = 1;
+static unsigned char latestIndex = 2;
+static unsigned long publishedSeq = 0;
+static unsigned long consumedSeq = 0;
+static unsigned long overwrittenSamples = 0;
+
+/**
+ * publish a new altitude sample to the control thread, it never blocks
+ *
+ * @param altitude
+ * 		altitude (cm)
+ *
+ * @param tv
+ * 		time of measurement
+ *
+ * @return
+ *		void
+ *
+ */
+void publishAltitudeSample(float altitude, struct timeval *tv) {
+
+	ALTITUDE_SAMPLE_STRUCT *sample = &altitudeSamples[writeIndex];
+
+	sample->tv = *tv;
+	sample->altitude = altitude;
+	sample->seq = ++publishedSeq;
+
+	writeIndex = __atomic_exchange_n(&latestIndex,
+			writeIndex | ALTITUDE_SAMPLE_FRESH, __ATOMIC_ACQ_REL)
+			& ALTITUDE_SAMPLE_INDEX_MASK;
+}
+
+/**
+ * take the newest altitude sample in the control thread, it never blocks
+ *
+ * @param sample
+ * 		newest sample
+ *
+ * @return
+ *		false if no sample is published since last call
+ *
+ */
+bool consumeAltitudeSample(ALTITUDE_SAMPLE_STRUCT *sample) {
+
+	if (!(__atomic_load_n(&latestIndex, __ATOMIC_RELAXED)
+			& ALTITUDE_SAMPLE_FRESH)) {
+		return false;
+	}
+
+	readIndex = __atomic_exchange_n(&latestIndex, readIndex, __ATOMIC_ACQ_REL)
+			& ALTITUDE_SAMPLE_INDEX_MASK;
+	*sample = altitudeSamples[readIndex];
+
+	if (sample->seq > consumedSeq + 1) {
+		overwrittenSamples += sample->seq - consumedSeq - 1;
+	}
+	consumedSeq = sample->seq;
+
+	return true;
+}
+
+/**
+ * get age of an altitude sample
+ *
+ * @param sample
+ * 		sample
+ *
+ * @return
+ *		time since the sample is measured (us)
+ *
+ */
+unsigned long getAltitudeSampleAge(ALTITUDE_SAMPLE_STRUCT *sample) {
+
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+
+	return GET_USEC_TIMEDIFF(tv, sample->tv);
+}
+
+/**
+ * get number of samples which are overwritten before the control thread takes them
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		number of overwritten samples
+ *
+ */
+unsigned long getOverwrittenAltitudeSamples() {
+	return overwrittenSamples;
+}
@@ -1,5 +1,5 @@
 /******************************************************************************
-The smaFilter.h in RaspberryPilot project is placed under the MIT license
+The altitudeSample.h in RaspberryPilot project is placed under the MIT license
 
 Copyright (c) 2016 jellyice1986 (Tung-Cheng Wu)
 
@@ -22,16 +22,13 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 ******************************************************************************/
 
-#define SMA_BUFER_SIZE 100
-
 typedef struct {
-	char  name[10]; //name of SMA entity
-	float buf[SMA_BUFER_SIZE];
-    unsigned int movAgeSize;     // size of window of SMA filter
-    unsigned int curIndex; 
-} SMA_STRUCT;
-
-void initSmaFilterEntity(SMA_STRUCT *smaStruct,char *name, int movAgeSize);
-void pushSmaData(SMA_STRUCT *smaStruct, float val);
-float pullSmaData(SMA_STRUCT *smaStruct);
-
+	float altitude; // cm
+	unsigned long seq; // starts from 1, increases by one in every published sample
+	struct timeval tv; // time of measurement
+} ALTITUDE_SAMPLE_STRUCT;
+
+void publishAltitudeSample(float altitude, struct timeval *tv);
+bool consumeAltitudeSample(ALTITUDE_SAMPLE_STRUCT *sample);
+unsigned long getAltitudeSampleAge(ALTITUDE_SAMPLE_STRUCT *sample);
+unsigned long getOverwrittenAltitudeSamples();
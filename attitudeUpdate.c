@@ -30,12 +30,15 @@ SOFTWARE.
 #include "cJSON.h"
 #include "commonLib.h"
 #include "ahrs.h"
-#include "smaFilter.h"
+#include "kalmanFilter.h"
+#include "filter.h"
 #include "flyControler.h"
 #include "mpu6050.h"
+#include "dynamicNotch.h"
 #include "attitudeUpdate.h"
 
 #define CHECK_ATTITUDE_UPDATE_LOOP_TIME 0
+#define MAGNET_MAX_SAMPLE_AGE (3 * getMagnetSamplePeriod()) // us, fall back to 6 axis update when magnet data stop
 
 static bool attitudeIsInit;
 static float verticalAcceleration;
@@ -54,14 +57,21 @@ static float xGravity;
 static float yGravity;
 static float zGravity;
 static short imuRawData[9];
+static MPU6050_MOTION_STRUCT motionSamples[MPU6050_FIFO_MAX_SAMPLES];
+static struct timeval lastSampleTv;
+#if !defined(MPU6050_FIFO) && !defined(MPU6050_DATA_READY_INTERRUPT)
+static MPU6050_MOTION_STRUCT lastPolledMotion; // registers are polled faster than the output data rate
+#endif
 #ifdef MPU6050_9AXIS
 // Hard iron calibration matrix
 float mag_hard_iron_cal[3];
 // Soft iron calibration matrix
 float mag_soft_iron_cal[3][3];
-static SMA_STRUCT x_magnetSmaFilterEntry;
-static SMA_STRUCT y_magnetSmaFilterEntry;
-static SMA_STRUCT z_magnetSmaFilterEntry;
+static FILTER_STRUCT x_magnetSmaFilterEntry;
+static FILTER_STRUCT y_magnetSmaFilterEntry;
+static FILTER_STRUCT z_magnetSmaFilterEntry;
+static float magnet[3]; // latest calibrated and filtered magnet sample
+static struct timeval magnetTv; // time of latest magnet sample
 #endif
 
 void *attitudeUpdateThread();
@@ -69,8 +79,11 @@ static void GetXComponent(float *x, float *q);
 static void GetYComponent(float *y, float *q);
 static void GetZComponent(float *z, float *q);
 static unsigned char GetYawPitchRoll(float *data, float *q, float *gravity);
-static void getYawPitchRollInfo(float *yprAttitude, float *yprRate,
+static bool getYawPitchRollInfo(float *yprAttitude, float *yprRate,
 		float *xyzAcc, float *xComponent, float *yComponent, float *zComponent, float *xyzMagnet);
+#if !defined(MPU6050_FIFO) && !defined(MPU6050_DATA_READY_INTERRUPT)
+static bool motionIsRepeated(MPU6050_MOTION_STRUCT *motion);
+#endif
 
 /**
  * init paramtes and states for attitudeUpdate
@@ -104,11 +117,15 @@ bool altitudeUpdateInit() {
 		mag_soft_iron_cal[2][0],mag_soft_iron_cal[2][1],mag_soft_iron_cal[2][2]);
 
 #ifdef MPU6050_9AXIS
-	initSmaFilterEntity(&x_magnetSmaFilterEntry,"X_MAGNET",2);
-	initSmaFilterEntity(&y_magnetSmaFilterEntry,"Y_MAGNET",2);
-	initSmaFilterEntity(&z_magnetSmaFilterEntry,"Z_MAGNET",2);
+	initSmaFilter(&x_magnetSmaFilterEntry,"X_MAGNET",2);
+	initSmaFilter(&y_magnetSmaFilterEntry,"Y_MAGNET",2);
+	initSmaFilter(&z_magnetSmaFilterEntry,"Z_MAGNET",2);
 #endif	
 
+#ifdef DYNAMIC_NOTCH
+	dynamicNotchInit();
+#endif
+
 	attitudeIsInit=true;
 
 	return true;
@@ -122,10 +139,10 @@ bool altitudeUpdateInit() {
  * 		void
  *
  * @return
- *		void
+ *		bool, false if no new IMU sample was integrated
  *
  */
-void attitudeUpdate(){
+bool attitudeUpdate(){
 
 	float yrpAttitude[3];
 	float pryRate[3];
@@ -145,7 +162,9 @@ void attitudeUpdate(){
 	UPDATE_LAST_TIME(tv_c,tv_l);
 #endif	
 			
-	getYawPitchRollInfo(yrpAttitude, pryRate, xyzAcc, xComponent, yComponent, zComponent,xyzMagnet); 
+	if(!getYawPitchRollInfo(yrpAttitude, pryRate, xyzAcc, xComponent, yComponent, zComponent,xyzMagnet)){
+		return false;
+	}
 
 	setYaw(yrpAttitude[0]);
 	setRoll(yrpAttitude[1]);
@@ -175,7 +194,8 @@ void attitudeUpdate(){
 			getYawGyro());
 	_DEBUG(DEBUG_ACC, "(%s-%d) ACC: x=%3.3f y=%3.3f z=%3.3f\n",
 			__func__, __LINE__, getXAcc(), getYAcc(), getZAcc());
-	
+
+	return true;
 }
 
 /**
@@ -539,6 +559,20 @@ float getZAcc() {
 	return zAcc;
 }
 
+/**
+ * get the timestamp of the latest IMU sample integrated by attitudeUpdate
+ *
+ * @param tv
+ * 		timestamp, tv_usec is 0 before the first sample
+ *
+ * @return
+ *		void
+ *
+ */
+void getAttitudeSampleTv(struct timeval *tv) {
+	*tv = lastSampleTv;
+}
+
 /**
  * get yaw, pitch and roll information
  *
@@ -561,7 +595,7 @@ float getZAcc() {
  *		void
  *
  */
-void getYawPitchRollInfo(float *yprAttitude, float *yprRate,
+bool getYawPitchRollInfo(float *yprAttitude, float *yprRate,
 		float *xyzAcc, float *xComponent, float *yComponent, float *zComponent, float *xyzMagnet) {
 
 	float q[4];		    // [w, x, y, z]         quaternion container
@@ -574,7 +608,13 @@ void getYawPitchRollInfo(float *yprAttitude, float *yprRate,
 	float gx = 0.f;
 	float gy = 0.f;
 	float gz = 0.f;
+	float rate[3];
+	float timeDiff = 0.f;
+	int sampleCount = 0;
+	int i = 0;
 #ifdef MPU6050_9AXIS
+	bool magnetIsValid = false;
+	struct timeval tv;
 	short s_mx=0;
 	short s_my=0;
 	short s_mz=0;
@@ -586,10 +626,25 @@ void getYawPitchRollInfo(float *yprAttitude, float *yprRate,
 	float f_z=0.f;
 #endif
 
-	getMotion6(&ax, &ay, &az, &gx, &gy, &gz);
+#ifdef MPU6050_FIFO
+	sampleCount = getMotion6FifoData(motionSamples, MPU6050_FIFO_MAX_SAMPLES);
+#else
+	sampleCount = getMotion7(&motionSamples[0]) ? 1 : 0;
+#ifndef MPU6050_DATA_READY_INTERRUPT
+	if(sampleCount && motionIsRepeated(&motionSamples[0])){
+		sampleCount = 0;
+	}
+#endif
+#endif
+
+	if(0 == sampleCount){
+		return false;
+	}
 
 #ifdef MPU6050_9AXIS
-	if(pollingMagnetDataBySingleMeasurementMode(&s_mx, &s_my, &s_mz)){
+	// AK8963 measures continuously at its own rate, the latest sample is used until it is too old
+	gettimeofday(&tv, NULL);
+	if(pollingMagnetDataByContinuousMode(&s_mx, &s_my, &s_mz)){
 		
 		f_x = (float)s_mx - mag_hard_iron_cal[0];
 		f_y = (float)s_my - mag_hard_iron_cal[1];
@@ -598,23 +653,41 @@ void getYawPitchRollInfo(float *yprAttitude, float *yprRate,
 		f_my = f_x * mag_soft_iron_cal[1][0] + f_y * mag_soft_iron_cal[1][1] + f_z * mag_soft_iron_cal[1][2];
 		f_mz = f_x * mag_soft_iron_cal[2][0] + f_y * mag_soft_iron_cal[2][1] + f_z * mag_soft_iron_cal[2][2];
 
-		pushSmaData(&x_magnetSmaFilterEntry,f_mx);
-		pushSmaData(&y_magnetSmaFilterEntry,f_my);
-		pushSmaData(&z_magnetSmaFilterEntry,f_mz);
-		f_mx = pullSmaData(&x_magnetSmaFilterEntry);
-		f_my = pullSmaData(&y_magnetSmaFilterEntry);
-		f_mz = pullSmaData(&z_magnetSmaFilterEntry);
-	
-		IMUupdate9(gx, gy, gz, ax, ay, az, f_my, f_mx, f_mz, q);
-		
-	}else{
-		IMUupdate6(gx, gy, gz, ax, ay, az, q);
+		magnet[0] = filterUpdate(&x_magnetSmaFilterEntry,f_mx);
+		magnet[1] = filterUpdate(&y_magnetSmaFilterEntry,f_my);
+		magnet[2] = filterUpdate(&z_magnetSmaFilterEntry,f_mz);
+		UPDATE_LAST_TIME(tv, magnetTv);
 	}
-	
+	magnetIsValid = TIME_IS_UPDATED(magnetTv)
+			&& GET_USEC_TIMEDIFF(tv, magnetTv) < MAGNET_MAX_SAMPLE_AGE;
+#endif
+
+	// integrate every sample with the time elapsed since the previous one
+	for(i = 0; i < sampleCount; i++){
+
+		convertMotion6RawData(&motionSamples[i], &ax, &ay, &az, &gx, &gy, &gz);
+		timeDiff = TIME_IS_UPDATED(lastSampleTv) ? GET_SEC_TIMEDIFF(motionSamples[i].tv, lastSampleTv) : 0.f;
+		UPDATE_LAST_TIME(motionSamples[i].tv, lastSampleTv);
+
+#ifdef MPU6050_9AXIS
+		if(magnetIsValid){
+			IMUupdate9(gx, gy, gz, ax, ay, az, magnet[1], magnet[0], magnet[2], timeDiff, q);
+		}else{
+			IMUupdate6(gx, gy, gz, ax, ay, az, timeDiff, q);
+		}
 #else
-	IMUupdate6(gx, gy, gz, ax, ay, az, q);
+		IMUupdate6(gx, gy, gz, ax, ay, az, timeDiff, q);
 #endif	
 
+		rate[0] = gx * RA_TO_DE;
+		rate[1] = gy * RA_TO_DE;
+		rate[2] = gz * RA_TO_DE;
+#ifdef DYNAMIC_NOTCH
+		// AHRS has integrated the raw gyro, only the rate controlers see the filtered one
+		dynamicNotchUpdate(rate);
+#endif
+	}
+
 	GetXComponent(mXComponent, q);
 	GetYComponent(mYComponent, q);
 	GetZComponent(mZComponent, q);
@@ -633,15 +706,44 @@ void getYawPitchRollInfo(float *yprAttitude, float *yprRate,
 	zComponent[0] = mZComponent[0];
 	zComponent[1] = mZComponent[1];
 	zComponent[2] = mZComponent[2];
-	yprRate[0] = gx * RA_TO_DE;
-	yprRate[1] = gy * RA_TO_DE;
-	yprRate[2] = gz * RA_TO_DE;
+	yprRate[0] = rate[0];
+	yprRate[1] = rate[1];
+	yprRate[2] = rate[2];
 	xyzAcc[0] = ax;
 	xyzAcc[1] = ay;
 	xyzAcc[2] = az;
 
+	return true;
 }
 
+#if !defined(MPU6050_FIFO) && !defined(MPU6050_DATA_READY_INTERRUPT)
+/**
+ * check whether the polled registers still hold the previous sample,
+ * a new sample always differs in the noise of some axes
+ *
+ * @param motion
+ * 		polled motion
+ *
+ * @return
+ *		bool
+ *
+ */
+static bool motionIsRepeated(MPU6050_MOTION_STRUCT *motion) {
+
+	bool isRepeated = motion->ax == lastPolledMotion.ax
+			&& motion->ay == lastPolledMotion.ay
+			&& motion->az == lastPolledMotion.az
+			&& motion->temperature == lastPolledMotion.temperature
+			&& motion->gx == lastPolledMotion.gx
+			&& motion->gy == lastPolledMotion.gy
+			&& motion->gz == lastPolledMotion.gz;
+
+	lastPolledMotion = *motion;
+
+	return isRepeated;
+}
+#endif
+
 /**
  * get attitude
  *
@@ -776,10 +878,18 @@ void setMagnetCalIron(float soft_00,float soft_01,float soft_02,
  */
 void magnetCalibrationGetImuRawData(void){
 
-	if(pollingMagnetDataBySingleMeasurementMode(&imuRawData[6], &imuRawData[7], &imuRawData[8])){
+	MPU6050_MOTION_STRUCT motion;
 
-		getMotion6RawData(&imuRawData[0], &imuRawData[1], &imuRawData[2], &imuRawData[3], &imuRawData[4], &imuRawData[5]);	
+	// motion is read first, it may also bring the magnet data when AK8963 is behind the I2C master of MPU6050
+	if(getMotion7(&motion)
+		&& pollingMagnetDataByContinuousMode(&imuRawData[6], &imuRawData[7], &imuRawData[8])){
 
+		imuRawData[0] = motion.ax;
+		imuRawData[1] = motion.ay;
+		imuRawData[2] = motion.az;
+		imuRawData[3] = motion.gx;
+		imuRawData[4] = motion.gy;
+		imuRawData[5] = motion.gz;
 	}
 							
 }
@@ -23,7 +23,7 @@ SOFTWARE.
 ******************************************************************************/
 
 bool altitudeUpdateInit();
-void attitudeUpdate();
+bool attitudeUpdate();
 float getVerticalAcceleration();
 void setVerticalAcceleration(float v);
 float getXAcceleration();
@@ -54,6 +54,7 @@ void setZGravity(float z_gravity);
 float getXGravity();
 float getYGravity();
 float getZGravity();
+void getAttitudeSampleTv(struct timeval *tv);
 void setMagnetCalIron(float soft_00,float soft_01,float soft_02,
 		float soft_10,float soft_11,float soft_12,
 		float soft_20,float soft_21,float soft_22,
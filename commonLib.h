@@ -23,6 +23,7 @@
  ******************************************************************************/
 
 #define MAGNET_CAL_DATA_PATH "/home/pi/RaspberryPilot/Data/MagnetCal.data"
+#define VL53L0X_CAL_DATA_PATH "/home/pi/RaspberryPilot/Data/Vl53l0xCal.data"
 
 #define true (1==1)
 #define false (1==0)
@@ -60,7 +61,9 @@
 #define DEBUG_HOVER_NORMAL             DEBUG_NONE|0x00000001
 #define DEBUG_HOVER_RAW_ALTITUDE  	   DEBUG_NONE//|0x00000002
 #define DEBUG_HOVER_SPEED  	   		   DEBUG_NONE//|0x00000004
-#define DEBUG_HOVER_MASK 			   (DEBUG_HOVER_NORMAL|DEBUG_HOVER_RAW_ALTITUDE|DEBUG_HOVER_SPEED)
+#define DEBUG_HOVER_STATISTICS  	   DEBUG_NONE//|0x00000008
+#define DEBUG_HOVER_MASK 			   (DEBUG_HOVER_NORMAL|DEBUG_HOVER_RAW_ALTITUDE|DEBUG_HOVER_SPEED|\
+								DEBUG_HOVER_STATISTICS)
 #define _DEBUG_HOVER(type,str,arg...) do{ if(LOG_ENABLE && DEBUG_HOVER_ENABLE && ((type) & DEBUG_HOVER_MASK)) printf(str,## arg);}while(0)
 
 #define _ERROR(str,arg...) do{ if(LOG_ENABLE) printf(str,## arg);}while(0)
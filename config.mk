@@ -26,6 +26,21 @@
 #set up this flag to n if you haven't calibrated your magnetometer
 CONFIG_MPU6050_9AXIS_SUPPORT :=y
 
+#Read AK8963 through the I2C master of MPU6050 instead of bypass mode (9DOF only),
+#magnet data are fetched together with accelerometer and gyro by the same burst read
+CONFIG_MPU6050_AUX_I2C_MAGNET_SUPPORT :=n
+
+#Read accelerometer and gyro through the MPU6050 FIFO, every sample produced between two control cycles is integrated by AHRS
+CONFIG_MPU6050_FIFO_SUPPORT :=n
+
+#Run the control cycle once per MPU6050 sample by waiting for the edge of DATA_RDY interrupt instead of polling
+#MPU6050 INT pin must be wired to the following GPIO (wiringPi numbering)
+CONFIG_MPU6050_DATA_READY_INTERRUPT_SUPPORT :=n
+CONFIG_MPU6050_INT_WIRINGPI_PIN :=0
+
+#Track motor vibration in the gyro by FFT and remove it with notch filters before the rate PID controlers
+CONFIG_DYNAMIC_NOTCH_SUPPORT :=n
+
 #Define the PCA9685 channel which is used to generate PWM signal to the ESCs at CCW1,CCW2,CW1 and CW2
 #
 # 	  (motor#2) CCW2    CW2  (motor#3)
@@ -55,21 +70,49 @@ CONFIG_ESC_STANDARD_PWM_SUPPORT :=y
 CONFIG_ESC_PWM_SYNC_SUPPORT 	:=n
 CONFIG_ESC_ONESHOT125_SUPPORT   :=n
 
+#Run the control cycle in a real-time thread (SCHED_FIFO) with locked memory and pin it on its own CPU core,
+#radio and althold threads are pinned on another core
+CONFIG_RT_CONTROL_THREAD_SUPPORT :=n
+CONFIG_RT_CONTROL_THREAD_PRIORITY :=80
+CONFIG_RT_CONTROL_THREAD_CPU :=3
+CONFIG_RT_NON_RT_THREAD_CPU :=2
+
 #Choose a sensor type for althold, only one of the following setting will be applied
 CONFIG_ALTHOLD_MS5611_SUPPORT  :=y
 CONFIG_ALTHOLD_SRF02_SUPPORT   :=n
 CONFIG_ALTHOLD_VL53L0X_SUPPORT :=n
 
+#Collect VL53L0X continuous ranging on the falling edge of its GPIO1 pin instead of polling the status register
+#VL53L0X GPIO1 pin must be wired to the following GPIO (wiringPi numbering)
+CONFIG_VL53L0X_GPIO1_INTERRUPT_SUPPORT :=n
+CONFIG_VL53L0X_GPIO1_WIRINGPI_PIN :=1
+
 ######### Don't Modify The Following Code #########
 
 DEFAULT_CFLAGS += -O0 -Wall
 
 ifeq ($(CONFIG_MPU6050_9AXIS_SUPPORT),y)
 	DEFAULT_CFLAGS += -DMPU6050_9AXIS
+ifeq ($(CONFIG_MPU6050_AUX_I2C_MAGNET_SUPPORT),y)
+	DEFAULT_CFLAGS += -DMPU6050_AUX_I2C_MAGNET
+endif
 else
 	DEFAULT_CFLAGS += -DMPU6050_6AXIS
 endif
 
+ifeq ($(CONFIG_MPU6050_FIFO_SUPPORT),y)
+	DEFAULT_CFLAGS += -DMPU6050_FIFO
+endif
+
+ifeq ($(CONFIG_DYNAMIC_NOTCH_SUPPORT),y)
+	DEFAULT_CFLAGS += -DDYNAMIC_NOTCH
+endif
+
+ifeq ($(CONFIG_MPU6050_DATA_READY_INTERRUPT_SUPPORT),y)
+	DEFAULT_CFLAGS += -DMPU6050_DATA_READY_INTERRUPT
+	DEFAULT_CFLAGS += -DMPU6050_INT_PIN=$(CONFIG_MPU6050_INT_WIRINGPI_PIN)
+endif
+
 DEFAULT_CFLAGS += -DSOFT_PWM_CCW1=$(CONFIG_ESC_PCA9685_CHANNEL_CCW1)
 DEFAULT_CFLAGS += -DSOFT_PWM_CW1=$(CONFIG_ESC_PCA9685_CHANNEL_CW1)
 DEFAULT_CFLAGS += -DSOFT_PWM_CCW2=$(CONFIG_ESC_PCA9685_CHANNEL_CCW2)
@@ -94,6 +137,13 @@ else
 	endif
 endif
 
+ifeq ($(CONFIG_RT_CONTROL_THREAD_SUPPORT),y)
+	DEFAULT_CFLAGS += -DRT_CONTROL_THREAD
+	DEFAULT_CFLAGS += -DRT_CONTROL_THREAD_PRIORITY=$(CONFIG_RT_CONTROL_THREAD_PRIORITY)
+	DEFAULT_CFLAGS += -DRT_CONTROL_THREAD_CPU=$(CONFIG_RT_CONTROL_THREAD_CPU)
+	DEFAULT_CFLAGS += -DRT_NON_RT_THREAD_CPU=$(CONFIG_RT_NON_RT_THREAD_CPU)
+endif
+
 ifeq ($(CONFIG_ALTHOLD_MS5611_SUPPORT),y)
 	DEFAULT_CFLAGS += -DALTHOLD_MODULE_MS5611
 else	
@@ -102,6 +152,10 @@ else
 	else	
 		ifeq ($(CONFIG_ALTHOLD_VL53L0X_SUPPORT),y)
 			DEFAULT_CFLAGS += -DALTHOLD_MODULE_VL53L0X
+			ifeq ($(CONFIG_VL53L0X_GPIO1_INTERRUPT_SUPPORT),y)
+				DEFAULT_CFLAGS += -DVL53L0X_GPIO1_INTERRUPT
+				DEFAULT_CFLAGS += -DVL53L0X_GPIO1_PIN=$(CONFIG_VL53L0X_GPIO1_WIRINGPI_PIN)
+			endif
 		endif	
 	endif	
 endif
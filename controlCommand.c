@@ -0,0 +1,104 @@
+/******************************************************************************
+The controlCommand.c in RaspberryPilot project is placed under the MIT license
+
+Copyright (c) 2016 jellyice1986 (Tung-Cheng Wu)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include "commonLib.h"
+#include "controlCommand.h"
+
+/**
+ * single-producer single-consumer ring:
+ * the radio receive thread is the only producer and moves head,
+ * the control thread is the only consumer and moves tail
+ */
+static CONTROL_COMMAND_STRUCT commandQueue[CONTROL_COMMAND_QUEUE_SIZE];
+static unsigned long commandQueueHead = 0;
+static unsigned long commandQueueTail = 0;
+static unsigned long droppedCommands = 0;
+
+/**
+ * push a command to the control thread, it never blocks
+ *
+ * @param command
+ * 		command
+ *
+ * @return
+ *		false if queue is full
+ *
+ */
+bool pushControlCommand(CONTROL_COMMAND_STRUCT *command) {
+
+	unsigned long head = __atomic_load_n(&commandQueueHead, __ATOMIC_RELAXED);
+
+	if (head - __atomic_load_n(&commandQueueTail, __ATOMIC_ACQUIRE)
+			>= CONTROL_COMMAND_QUEUE_SIZE) {
+		droppedCommands++;
+		return false;
+	}
+
+	memcpy(&commandQueue[head & (CONTROL_COMMAND_QUEUE_SIZE - 1)], command,
+			sizeof(CONTROL_COMMAND_STRUCT));
+	__atomic_store_n(&commandQueueHead, head + 1, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+/**
+ * pop a command in the control thread, it never blocks
+ *
+ * @param command
+ * 		command
+ *
+ * @return
+ *		false if queue is empty
+ *
+ */
+bool popControlCommand(CONTROL_COMMAND_STRUCT *command) {
+
+	unsigned long tail = __atomic_load_n(&commandQueueTail, __ATOMIC_RELAXED);
+
+	if (tail == __atomic_load_n(&commandQueueHead, __ATOMIC_ACQUIRE)) {
+		return false;
+	}
+
+	memcpy(command, &commandQueue[tail & (CONTROL_COMMAND_QUEUE_SIZE - 1)],
+			sizeof(CONTROL_COMMAND_STRUCT));
+	__atomic_store_n(&commandQueueTail, tail + 1, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+/**
+ * get number of commands which are dropped because the queue is full
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		number of dropped commands
+ *
+ */
+unsigned long getDroppedControlCommands() {
+	return droppedCommands;
+}
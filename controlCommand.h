@@ -0,0 +1,50 @@
+/******************************************************************************
+The controlCommand.h in RaspberryPilot project is placed under the MIT license
+
+Copyright (c) 2016 jellyice1986 (Tung-Cheng Wu)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+******************************************************************************/
+
+#define CONTROL_COMMAND_QUEUE_SIZE 16 // must be a power of 2
+
+typedef enum {
+	CONTROL_COMMAND_ENABLE_FLY_SYSTEM,
+	CONTROL_COMMAND_CONTROL_MOTION,
+	CONTROL_COMMAND_HALT,
+	CONTROL_COMMAND_SETUP_PID_EXTENSION
+} CONTROL_COMMAND_TYPE;
+
+typedef struct {
+	CONTROL_COMMAND_TYPE type;
+	bool isEnable;
+	unsigned short throttle;
+	float throttlePercentage;
+	float rollSpShift;
+	float pitchSpShift;
+	float yawShiftValue;
+	int pidIndex; // SETUP_PID_EXTENSION_CONTROLER_INDEX
+	bool dOnMeasurement;
+	float dCutoffFreq;
+	float ffGain;
+} CONTROL_COMMAND_STRUCT;
+
+bool pushControlCommand(CONTROL_COMMAND_STRUCT *command);
+bool popControlCommand(CONTROL_COMMAND_STRUCT *command);
+unsigned long getDroppedControlCommands();
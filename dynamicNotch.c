@@ -0,0 +1,434 @@
+/******************************************************************************
+The dynamicNotch.c in RaspberryPilot project is placed under the MIT license
+
+Copyright (c) 2016 jellyice1986 (Tung-Cheng Wu)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <sys/time.h>
+#include "commonLib.h"
+#include "kalmanFilter.h"
+#include "filter.h"
+#include "mpu6050.h"
+#include "dynamicNotch.h"
+
+#define CHECK_DYNAMIC_NOTCH 0 // inject a tone into the gyro stream and print the statistics, bench test only
+#define CHECK_DYNAMIC_NOTCH_FREQ 180.f // Hz
+#define CHECK_DYNAMIC_NOTCH_AMPLITUDE 20.f // deg/s
+#define CHECK_DYNAMIC_NOTCH_REPORT_PERIOD 5000000 // us
+
+#define DYNAMIC_NOTCH_PI 3.14159265358979f
+#define DYNAMIC_NOTCH_HALF_SIZE (DYNAMIC_NOTCH_FFT_SIZE / 2) // size of the complex FFT which carries the real input
+#define DYNAMIC_NOTCH_HALF_SIZE_BITS 6
+#define DYNAMIC_NOTCH_MIN_FREQ 80.f // Hz, frame resonance and prop wash stay below it
+#define DYNAMIC_NOTCH_MAX_FREQ 400.f // Hz, also limited to 0.45 * sample rate
+#define DYNAMIC_NOTCH_Q 3.f
+#define DYNAMIC_NOTCH_MIN_PEAK_RATIO 5.f // peak power over average power of the band
+#define DYNAMIC_NOTCH_SMOOTHING 0.3f // weight of a new peak on center frequency
+#define DYNAMIC_NOTCH_DEFAULT_DIVIDER 8 // one axis is analysed every DIVIDER gyro samples
+#define DYNAMIC_NOTCH_MAX_DIVIDER 64
+#define DYNAMIC_NOTCH_FFT_BUDGET 150 // us, the divider is doubled when an analysis takes longer
+
+static void pushSample(DYNAMIC_NOTCH_AXIS_STRUCT *axis, float sample);
+static void analyseAxis(DYNAMIC_NOTCH_AXIS_STRUCT *axis, float sampleRate);
+static void complexFft(float *re, float *im);
+static float findPeakFreq(float sampleRate);
+
+static DYNAMIC_NOTCH_AXIS_STRUCT notchAxis[DYNAMIC_NOTCH_AXIS_NUM];
+static float window[DYNAMIC_NOTCH_FFT_SIZE];
+static float twiddleCos[DYNAMIC_NOTCH_HALF_SIZE];
+static float twiddleSin[DYNAMIC_NOTCH_HALF_SIZE];
+static unsigned char bitReverse[DYNAMIC_NOTCH_HALF_SIZE];
+static float fftRe[DYNAMIC_NOTCH_HALF_SIZE];
+static float fftIm[DYNAMIC_NOTCH_HALF_SIZE];
+static float power[DYNAMIC_NOTCH_HALF_SIZE];
+static unsigned int fftDivider;
+static unsigned int sampleCount;
+static unsigned char nextAxis;
+static unsigned long analysisCount;
+static unsigned long overBudgetCount;
+static long maxAnalysisNsec;
+static long totalAnalysisNsec;
+
+/**
+ * init the dynamic notch of gyro, the Hann window and the tables of FFT are prepared here
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		void
+ *
+ */
+void dynamicNotchInit() {
+
+	int i = 0;
+	int j = 0;
+	unsigned char reversed = 0;
+
+	memset(notchAxis, 0, sizeof(notchAxis));
+
+	for (i = 0; i < DYNAMIC_NOTCH_FFT_SIZE; i++) {
+		window[i] = 0.5f
+				* (1.f
+						- cosf(2.f * DYNAMIC_NOTCH_PI * i
+								/ (DYNAMIC_NOTCH_FFT_SIZE - 1)));
+	}
+
+	for (i = 0; i < DYNAMIC_NOTCH_HALF_SIZE; i++) {
+		// W_N^k of the whole window, the complex FFT uses every second one
+		twiddleCos[i] = cosf(2.f * DYNAMIC_NOTCH_PI * i / DYNAMIC_NOTCH_FFT_SIZE);
+		twiddleSin[i] = sinf(2.f * DYNAMIC_NOTCH_PI * i / DYNAMIC_NOTCH_FFT_SIZE);
+
+		reversed = 0;
+		for (j = 0; j < DYNAMIC_NOTCH_HALF_SIZE_BITS; j++) {
+			reversed |= ((i >> j) & 0x1) << (DYNAMIC_NOTCH_HALF_SIZE_BITS - 1 - j);
+		}
+		bitReverse[i] = reversed;
+	}
+
+	fftDivider = DYNAMIC_NOTCH_DEFAULT_DIVIDER;
+	sampleCount = 0;
+	nextAxis = 0;
+	analysisCount = 0;
+	overBudgetCount = 0;
+	maxAnalysisNsec = 0;
+	totalAnalysisNsec = 0;
+}
+
+/**
+ * feed a gyro sample and filter it by the notches, it is called once for every sample of MPU6050,
+ * the spectrum of one axis is analysed every few samples, so the cost of a cycle stays bounded
+ *
+ * @param gyro
+ * 		gyro of DYNAMIC_NOTCH_AXIS_NUM axes (deg/s), they are replaced by the filtered ones
+ *
+ * @return
+ *		void
+ *
+ */
+void dynamicNotchUpdate(float *gyro) {
+
+	struct timespec start;
+	struct timespec end;
+	long nsec = 0;
+	float sampleRate = 1000000.f / (float) getMpu6050SamplePeriod();
+	int i = 0;
+#if CHECK_DYNAMIC_NOTCH
+	static unsigned long checkSampleCount = 0;
+	static struct timeval report_tv;
+	struct timeval tv;
+	float tone = CHECK_DYNAMIC_NOTCH_AMPLITUDE
+			* sinf(2.f * DYNAMIC_NOTCH_PI * CHECK_DYNAMIC_NOTCH_FREQ
+					* (float) checkSampleCount++ / sampleRate);
+
+	for (i = 0; i < DYNAMIC_NOTCH_AXIS_NUM; i++) {
+		gyro[i] += tone;
+	}
+#endif
+
+	for (i = 0; i < DYNAMIC_NOTCH_AXIS_NUM; i++) {
+		pushSample(&notchAxis[i], gyro[i]);
+	}
+
+	if (++sampleCount >= fftDivider
+			&& notchAxis[nextAxis].count >= DYNAMIC_NOTCH_FFT_SIZE) {
+
+		sampleCount = 0;
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		analyseAxis(&notchAxis[nextAxis], sampleRate);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		nextAxis = (nextAxis + 1) % DYNAMIC_NOTCH_AXIS_NUM;
+
+		nsec = (end.tv_sec - start.tv_sec) * 1000000000L
+				+ (end.tv_nsec - start.tv_nsec);
+		analysisCount++;
+		totalAnalysisNsec += nsec;
+		maxAnalysisNsec = max(maxAnalysisNsec, nsec);
+		if (nsec > DYNAMIC_NOTCH_FFT_BUDGET * 1000L) {
+			overBudgetCount++;
+			if (fftDivider < DYNAMIC_NOTCH_MAX_DIVIDER) {
+				fftDivider *= 2;
+				_DEBUG(DEBUG_NORMAL,
+						"dynamic notch: analysis takes %ld us, analyse every %d samples\n",
+						nsec / 1000, fftDivider);
+			}
+		}
+	}
+
+	for (i = 0; i < DYNAMIC_NOTCH_AXIS_NUM; i++) {
+		if (notchAxis[i].isTracking) {
+			gyro[i] = biquadApply(&notchAxis[i].notch, gyro[i]);
+		}
+	}
+
+#if CHECK_DYNAMIC_NOTCH
+	gettimeofday(&tv, NULL);
+	if (GET_USEC_TIMEDIFF(tv, report_tv) >= CHECK_DYNAMIC_NOTCH_REPORT_PERIOD) {
+		dynamicNotchPrintStatistics();
+		UPDATE_LAST_TIME(tv, report_tv);
+	}
+#endif
+}
+
+/**
+ * get center frequency of the notch of an axis
+ *
+ * @param axis
+ * 		index of axis
+ *
+ * @return
+ *		center frequency (Hz), 0 if no peak is tracked
+ *
+ */
+float getDynamicNotchCenterFreq(unsigned char axis) {
+
+	if (axis >= DYNAMIC_NOTCH_AXIS_NUM || !notchAxis[axis].isTracking) {
+		return 0.f;
+	}
+
+	return notchAxis[axis].centerFreq;
+}
+
+/**
+ * print center frequencies and the cost of spectrum analysis
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		void
+ *
+ */
+void dynamicNotchPrintStatistics() {
+
+	_DEBUG(DEBUG_NORMAL,
+			"dynamic notch: center=%.1f/%.1f/%.1f Hz, analysis avg=%ld us max=%ld us, over budget=%ld/%ld, divider=%d\n",
+			getDynamicNotchCenterFreq(0), getDynamicNotchCenterFreq(1),
+			getDynamicNotchCenterFreq(2),
+			analysisCount ? totalAnalysisNsec / 1000 / (long) analysisCount : 0,
+			maxAnalysisNsec / 1000, overBudgetCount, analysisCount, fftDivider);
+}
+
+/**
+ * put a sample into the rolling window of an axis
+ *
+ * @param axis
+ * 		axis entity
+ *
+ * @param sample
+ * 		raw gyro
+ *
+ * @return
+ *		void
+ *
+ */
+static void pushSample(DYNAMIC_NOTCH_AXIS_STRUCT *axis, float sample) {
+
+	axis->buf[axis->index] = sample;
+	axis->index = (axis->index + 1) % DYNAMIC_NOTCH_FFT_SIZE;
+	if (axis->count < DYNAMIC_NOTCH_FFT_SIZE) {
+		axis->count++;
+	}
+}
+
+/**
+ * find the strongest vibration of an axis and move its notch there
+ *
+ * @param axis
+ * 		axis entity
+ *
+ * @param sampleRate
+ * 		sample rate of gyro (Hz)
+ *
+ * @return
+ *		void
+ *
+ */
+static void analyseAxis(DYNAMIC_NOTCH_AXIS_STRUCT *axis, float sampleRate) {
+
+	float peakFreq = 0.f;
+	int i = 0;
+	int j = 0;
+
+	// the oldest sample is at index, even samples go to the real part and odd ones to the imaginary part
+	for (i = 0; i < DYNAMIC_NOTCH_HALF_SIZE; i++) {
+		j = (axis->index + 2 * i) % DYNAMIC_NOTCH_FFT_SIZE;
+		fftRe[i] = axis->buf[j] * window[2 * i];
+		j = (j + 1) % DYNAMIC_NOTCH_FFT_SIZE;
+		fftIm[i] = axis->buf[j] * window[2 * i + 1];
+	}
+
+	complexFft(fftRe, fftIm);
+
+	peakFreq = findPeakFreq(sampleRate);
+	if (peakFreq <= 0.f) {
+		return;
+	}
+
+	if (axis->isTracking) {
+		axis->centerFreq += DYNAMIC_NOTCH_SMOOTHING
+				* (peakFreq - axis->centerFreq);
+	} else {
+		axis->centerFreq = peakFreq;
+		biquadReset(&axis->notch);
+		axis->isTracking = true;
+	}
+
+	biquadSetNotch(&axis->notch, sampleRate, axis->centerFreq,
+			DYNAMIC_NOTCH_Q);
+}
+
+/**
+ * in-place radix-2 FFT of DYNAMIC_NOTCH_HALF_SIZE complex points
+ *
+ * @param re
+ * 		real part
+ *
+ * @param im
+ * 		imaginary part
+ *
+ * @return
+ *		void
+ *
+ */
+static void complexFft(float *re, float *im) {
+
+	int size = 0;
+	int half = 0;
+	int step = 0;
+	int start = 0;
+	int i = 0;
+	int a = 0;
+	int b = 0;
+	float wr = 0.f;
+	float wi = 0.f;
+	float tr = 0.f;
+	float ti = 0.f;
+
+	for (i = 0; i < DYNAMIC_NOTCH_HALF_SIZE; i++) {
+		if (bitReverse[i] > i) {
+			tr = re[i];
+			re[i] = re[bitReverse[i]];
+			re[bitReverse[i]] = tr;
+			ti = im[i];
+			im[i] = im[bitReverse[i]];
+			im[bitReverse[i]] = ti;
+		}
+	}
+
+	for (size = 2; size <= DYNAMIC_NOTCH_HALF_SIZE; size <<= 1) {
+
+		half = size >> 1;
+		step = DYNAMIC_NOTCH_FFT_SIZE / size;
+
+		for (start = 0; start < DYNAMIC_NOTCH_HALF_SIZE; start += size) {
+			for (i = 0; i < half; i++) {
+				wr = twiddleCos[i * step];
+				wi = -twiddleSin[i * step];
+				a = start + i;
+				b = a + half;
+				tr = wr * re[b] - wi * im[b];
+				ti = wr * im[b] + wi * re[b];
+				re[b] = re[a] - tr;
+				im[b] = im[a] - ti;
+				re[a] += tr;
+				im[a] += ti;
+			}
+		}
+	}
+}
+
+/**
+ * split the complex FFT into the spectrum of the real window and find its peak in the notch band,
+ * the peak is refined by parabolic interpolation between neighbouring bins
+ *
+ * @param sampleRate
+ * 		sample rate of gyro (Hz)
+ *
+ * @return
+ *		peak frequency (Hz), 0 if no clear peak
+ *
+ */
+static float findPeakFreq(float sampleRate) {
+
+	float binWidth = sampleRate / DYNAMIC_NOTCH_FFT_SIZE;
+	float maxFreq = min(DYNAMIC_NOTCH_MAX_FREQ, 0.45f * sampleRate);
+	int minBin = max(2, (int) ceilf(DYNAMIC_NOTCH_MIN_FREQ / binWidth));
+	int maxBin = min(DYNAMIC_NOTCH_HALF_SIZE - 2, (int) (maxFreq / binWidth));
+	int peakBin = 0;
+	int k = 0;
+	float evenRe = 0.f;
+	float evenIm = 0.f;
+	float oddRe = 0.f;
+	float oddIm = 0.f;
+	float xRe = 0.f;
+	float xIm = 0.f;
+	float sum = 0.f;
+	float left = 0.f;
+	float center = 0.f;
+	float right = 0.f;
+	float denominator = 0.f;
+	float delta = 0.f;
+
+	if (minBin >= maxBin) {
+		return 0.f;
+	}
+
+	for (k = minBin - 1; k <= maxBin + 1; k++) {
+		// X[k] = E[k] + W_N^k * O[k], E and O are the spectra of even and odd samples
+		evenRe = 0.5f * (fftRe[k] + fftRe[DYNAMIC_NOTCH_HALF_SIZE - k]);
+		evenIm = 0.5f * (fftIm[k] - fftIm[DYNAMIC_NOTCH_HALF_SIZE - k]);
+		oddRe = 0.5f * (fftIm[k] + fftIm[DYNAMIC_NOTCH_HALF_SIZE - k]);
+		oddIm = -0.5f * (fftRe[k] - fftRe[DYNAMIC_NOTCH_HALF_SIZE - k]);
+		xRe = evenRe + twiddleCos[k] * oddRe + twiddleSin[k] * oddIm;
+		xIm = evenIm + twiddleCos[k] * oddIm - twiddleSin[k] * oddRe;
+		power[k] = xRe * xRe + xIm * xIm;
+	}
+
+	peakBin = minBin;
+	for (k = minBin; k <= maxBin; k++) {
+		sum += power[k];
+		if (power[k] > power[peakBin]) {
+			peakBin = k;
+		}
+	}
+
+	if (power[peakBin] < DYNAMIC_NOTCH_MIN_PEAK_RATIO * sum / (maxBin - minBin + 1)) {
+		return 0.f;
+	}
+
+	left = sqrtf(power[peakBin - 1]);
+	center = sqrtf(power[peakBin]);
+	right = sqrtf(power[peakBin + 1]);
+	denominator = left - 2.f * center + right;
+	if (denominator != 0.f) {
+		delta = LIMIT_MIN_MAX_VALUE(0.5f * (left - right) / denominator, -0.5f,
+				0.5f);
+	}
+
+	return LIMIT_MIN_MAX_VALUE((peakBin + delta) * binWidth,
+			DYNAMIC_NOTCH_MIN_FREQ, maxFreq);
+}
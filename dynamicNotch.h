@@ -0,0 +1,40 @@
+/******************************************************************************
+The dynamicNotch.h in RaspberryPilot project is placed under the MIT license
+
+Copyright (c) 2016 jellyice1986 (Tung-Cheng Wu)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+******************************************************************************/
+
+#define DYNAMIC_NOTCH_FFT_SIZE 128 // gyro samples in one FFT window
+#define DYNAMIC_NOTCH_AXIS_NUM 3
+
+typedef struct {
+	float buf[DYNAMIC_NOTCH_FFT_SIZE]; // rolling window of raw gyro samples
+	unsigned int index; // next position in window
+	unsigned int count; // number of samples in window
+	bool isTracking; // a peak has been found, the notch is applied
+	float centerFreq; // center frequency of notch (Hz)
+	BIQUAD_STRUCT notch;
+} DYNAMIC_NOTCH_AXIS_STRUCT;
+
+void dynamicNotchInit();
+void dynamicNotchUpdate(float *gyro);
+float getDynamicNotchCenterFreq(unsigned char axis);
+void dynamicNotchPrintStatistics();
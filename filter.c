@@ -0,0 +1,507 @@
+/******************************************************************************
+The filter.c in RaspberryPilot project is placed under the MIT license
+
+Copyright (c) 2016 jellyice1986 (Tung-Cheng Wu)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "commonLib.h"
+#include "kalmanFilter.h"
+#include "filter.h"
+
+#define FILTER_SMA_RESUM_PERIOD 1000 // recompute the running sum every N pushes to remove accumulated rounding error
+#define FILTER_PI 3.14159265358979f
+
+static float smaUpdate(SMA_STRUCT *sma, float input);
+static float emaUpdate(EMA_STRUCT *ema, float input, float lastOutput);
+static float medianUpdate(MEDIAN_STRUCT *median, float input);
+static void initFilterEntity(FILTER_STRUCT *filter, char *name,
+		FILTER_TYPE type);
+
+/**
+ * init a simple moving average filter, the cost of each sample is O(1) regardless of the size of window
+ *
+ * @param filter
+ * 		filter entity
+ *
+ * @param name
+ * 		name of this entity
+ *
+ * @param size
+ * 		size of window, up to FILTER_SMA_MAX_SIZE
+ *
+ * @return
+ *		false if size is out of range, then it is limited to the range
+ *
+ */
+bool initSmaFilter(FILTER_STRUCT *filter, char *name, unsigned int size) {
+
+	bool result = true;
+
+	initFilterEntity(filter, name, FILTER_SMA);
+
+	if (size < 1 || size > FILTER_SMA_MAX_SIZE) {
+		_ERROR("(%s-%d) %s: size %d is out of range (1-%d)\n", __func__,
+				__LINE__, name, size, FILTER_SMA_MAX_SIZE);
+		size = LIMIT_MIN_MAX_VALUE(size, 1, FILTER_SMA_MAX_SIZE);
+		result = false;
+	}
+
+	filter->state.sma.size = size;
+
+	return result;
+}
+
+/**
+ * init a exponential moving average filter
+ *
+ * @param filter
+ * 		filter entity
+ *
+ * @param name
+ * 		name of this entity
+ *
+ * @param alpha
+ * 		weight of new sample, from 0 to 1
+ *
+ * @return
+ *		void
+ *
+ */
+void initEmaFilter(FILTER_STRUCT *filter, char *name, float alpha) {
+
+	initFilterEntity(filter, name, FILTER_EMA);
+	filter->state.ema.alpha = LIMIT_MIN_MAX_VALUE(alpha, 0.f, 1.f);
+	filter->state.ema.isInitialized = false;
+}
+
+/**
+ * init a median filter
+ *
+ * @param filter
+ * 		filter entity
+ *
+ * @param name
+ * 		name of this entity
+ *
+ * @param size
+ * 		size of window, up to FILTER_MEDIAN_MAX_SIZE
+ *
+ * @return
+ *		false if size is out of range, then it is limited to the range
+ *
+ */
+bool initMedianFilter(FILTER_STRUCT *filter, char *name, unsigned char size) {
+
+	bool result = true;
+
+	initFilterEntity(filter, name, FILTER_MEDIAN);
+
+	if (size < 1 || size > FILTER_MEDIAN_MAX_SIZE) {
+		_ERROR("(%s-%d) %s: size %d is out of range (1-%d)\n", __func__,
+				__LINE__, name, size, FILTER_MEDIAN_MAX_SIZE);
+		size = LIMIT_MIN_MAX_VALUE(size, 1, FILTER_MEDIAN_MAX_SIZE);
+		result = false;
+	}
+
+	filter->state.median.size = size;
+
+	return result;
+}
+
+/**
+ * init a biquad low pass filter
+ *
+ * @param filter
+ * 		filter entity
+ *
+ * @param name
+ * 		name of this entity
+ *
+ * @param sampleRate
+ * 		sample rate (Hz)
+ *
+ * @param cutoffFreq
+ * 		cutoff frequency (Hz)
+ *
+ * @param q
+ * 		quality factor, 0.7071 is Butterworth
+ *
+ * @return
+ *		void
+ *
+ */
+void initBiquadLowPassFilter(FILTER_STRUCT *filter, char *name,
+		float sampleRate, float cutoffFreq, float q) {
+
+	initFilterEntity(filter, name, FILTER_BIQUAD);
+	biquadSetLowPass(&filter->state.biquad, sampleRate, cutoffFreq, q);
+}
+
+/**
+ * init a biquad notch filter
+ *
+ * @param filter
+ * 		filter entity
+ *
+ * @param name
+ * 		name of this entity
+ *
+ * @param sampleRate
+ * 		sample rate (Hz)
+ *
+ * @param centerFreq
+ * 		center frequency (Hz)
+ *
+ * @param q
+ * 		quality factor, higher is narrower
+ *
+ * @return
+ *		void
+ *
+ */
+void initBiquadNotchFilter(FILTER_STRUCT *filter, char *name, float sampleRate,
+		float centerFreq, float q) {
+
+	initFilterEntity(filter, name, FILTER_BIQUAD);
+	biquadSetNotch(&filter->state.biquad, sampleRate, centerFreq, q);
+}
+
+/**
+ * init a 1 dimension Kalman filter
+ *
+ * @param filter
+ * 		filter entity
+ *
+ * @param name
+ * 		name of this entity
+ *
+ * @param prevData
+ * 		 previous data
+ *
+ * @param p
+ * 		 estimate covariance
+ *
+ * @param q
+ * 		 covariance of process noise
+ *
+ * @param r
+ * 		 covariance of observation noise
+ *
+ * @param kGain
+ * 		 Kalman gain
+ *
+ * @return
+ *		void
+ *
+ */
+void initKalmanFilter(FILTER_STRUCT *filter, char *name, float prevData,
+		float p, float q, float r, float kGain) {
+
+	initFilterEntity(filter, name, FILTER_KALMAN_1D);
+	initkalmanFilterOneDimEntity(&filter->state.kalman, name, prevData, p, q,
+			r, kGain);
+	filter->output = prevData;
+}
+
+/**
+ * push a sample into a filter
+ *
+ * @param filter
+ * 		filter entity
+ *
+ * @param input
+ * 		sample
+ *
+ * @return
+ *		output of filter
+ *
+ */
+float filterUpdate(FILTER_STRUCT *filter, float input) {
+
+	switch (filter->type) {
+	case FILTER_SMA:
+		filter->output = smaUpdate(&filter->state.sma, input);
+		break;
+	case FILTER_EMA:
+		filter->output = emaUpdate(&filter->state.ema, input, filter->output);
+		break;
+	case FILTER_MEDIAN:
+		filter->output = medianUpdate(&filter->state.median, input);
+		break;
+	case FILTER_BIQUAD:
+		filter->output = biquadApply(&filter->state.biquad, input);
+		break;
+	case FILTER_KALMAN_1D:
+		filter->output = kalmanFilterOneDimCalc(input, &filter->state.kalman);
+		break;
+	}
+
+	return filter->output;
+}
+
+/**
+ * get latest output of a filter
+ *
+ * @param filter
+ * 		filter entity
+ *
+ * @return
+ *		output of filter
+ *
+ */
+float getFilterOutput(FILTER_STRUCT *filter) {
+	return filter->output;
+}
+
+/**
+ * set coefficients of a biquad as low pass filter (RBJ cookbook), the state is kept
+ *
+ * @param biquad
+ * 		biquad section
+ *
+ * @param sampleRate
+ * 		sample rate (Hz)
+ *
+ * @param cutoffFreq
+ * 		cutoff frequency (Hz)
+ *
+ * @param q
+ * 		quality factor
+ *
+ * @return
+ *		void
+ *
+ */
+void biquadSetLowPass(BIQUAD_STRUCT *biquad, float sampleRate,
+		float cutoffFreq, float q) {
+
+	float omega = 2.f * FILTER_PI * cutoffFreq / sampleRate;
+	float cs = cosf(omega);
+	float alpha = sinf(omega) / (2.f * q);
+	float a0 = 1.f + alpha;
+
+	biquad->b0 = ((1.f - cs) * 0.5f) / a0;
+	biquad->b1 = (1.f - cs) / a0;
+	biquad->b2 = biquad->b0;
+	biquad->a1 = (-2.f * cs) / a0;
+	biquad->a2 = (1.f - alpha) / a0;
+}
+
+/**
+ * set coefficients of a biquad as notch filter (RBJ cookbook), the state is kept,
+ * so the center frequency can be moved while filtering
+ *
+ * @param biquad
+ * 		biquad section
+ *
+ * @param sampleRate
+ * 		sample rate (Hz)
+ *
+ * @param centerFreq
+ * 		center frequency (Hz)
+ *
+ * @param q
+ * 		quality factor
+ *
+ * @return
+ *		void
+ *
+ */
+void biquadSetNotch(BIQUAD_STRUCT *biquad, float sampleRate, float centerFreq,
+		float q) {
+
+	float omega = 2.f * FILTER_PI * centerFreq / sampleRate;
+	float cs = cosf(omega);
+	float alpha = sinf(omega) / (2.f * q);
+	float a0 = 1.f + alpha;
+
+	biquad->b0 = 1.f / a0;
+	biquad->b1 = (-2.f * cs) / a0;
+	biquad->b2 = biquad->b0;
+	biquad->a1 = biquad->b1;
+	biquad->a2 = (1.f - alpha) / a0;
+}
+
+/**
+ * clear the state of a biquad
+ *
+ * @param biquad
+ * 		biquad section
+ *
+ * @return
+ *		void
+ *
+ */
+void biquadReset(BIQUAD_STRUCT *biquad) {
+	biquad->z1 = 0.f;
+	biquad->z2 = 0.f;
+}
+
+/**
+ * apply a biquad to a sample, transposed direct form II
+ *
+ * @param biquad
+ * 		biquad section
+ *
+ * @param input
+ * 		sample
+ *
+ * @return
+ *		output
+ *
+ */
+float biquadApply(BIQUAD_STRUCT *biquad, float input) {
+
+	float output = biquad->b0 * input + biquad->z1;
+
+	biquad->z1 = biquad->b1 * input - biquad->a1 * output + biquad->z2;
+	biquad->z2 = biquad->b2 * input - biquad->a2 * output;
+
+	return output;
+}
+
+/**
+ * clear a filter entity and set its name and type
+ *
+ * @param filter
+ * 		filter entity
+ *
+ * @param name
+ * 		name of this entity
+ *
+ * @param type
+ * 		type of filter
+ *
+ * @return
+ *		void
+ *
+ */
+static void initFilterEntity(FILTER_STRUCT *filter, char *name,
+		FILTER_TYPE type) {
+
+	memset(filter, 0, sizeof(FILTER_STRUCT));
+	strncpy(filter->name, name, sizeof(filter->name) - 1);
+	filter->type = type;
+}
+
+/**
+ * update running sum of a SMA window, it is average of the samples received so far before the window is filled
+ *
+ * @param sma
+ * 		SMA state
+ *
+ * @param input
+ * 		sample
+ *
+ * @return
+ *		average
+ *
+ */
+static float smaUpdate(SMA_STRUCT *sma, float input) {
+
+	unsigned int i;
+
+	if (sma->count < sma->size) {
+		sma->count++;
+	} else {
+		sma->sum -= sma->buf[sma->index];
+	}
+
+	sma->buf[sma->index] = input;
+	sma->sum += input;
+	sma->index = (sma->index + 1) % sma->size;
+
+	if (++sma->pushes >= FILTER_SMA_RESUM_PERIOD) {
+		sma->sum = 0.f;
+		for (i = 0; i < sma->count; i++) {
+			sma->sum += sma->buf[i];
+		}
+		sma->pushes = 0;
+	}
+
+	return sma->sum / (float) sma->count;
+}
+
+/**
+ * update EMA, the first sample initializes the output
+ *
+ * @param ema
+ * 		EMA state
+ *
+ * @param input
+ * 		sample
+ *
+ * @param lastOutput
+ * 		previous output
+ *
+ * @return
+ *		output
+ *
+ */
+static float emaUpdate(EMA_STRUCT *ema, float input, float lastOutput) {
+
+	if (!ema->isInitialized) {
+		ema->isInitialized = true;
+		return input;
+	}
+
+	return lastOutput + ema->alpha * (input - lastOutput);
+}
+
+/**
+ * update median of a small window by insertion sort of a copy
+ *
+ * @param median
+ * 		median state
+ *
+ * @param input
+ * 		sample
+ *
+ * @return
+ *		median
+ *
+ */
+static float medianUpdate(MEDIAN_STRUCT *median, float input) {
+
+	float sorted[FILTER_MEDIAN_MAX_SIZE];
+	float v;
+	int i;
+	int j;
+
+	median->buf[median->index] = input;
+	median->index = (median->index + 1) % median->size;
+	if (median->count < median->size) {
+		median->count++;
+	}
+
+	for (i = 0; i < median->count; i++) {
+		v = median->buf[i];
+		for (j = i - 1; j >= 0 && sorted[j] > v; j--) {
+			sorted[j + 1] = sorted[j];
+		}
+		sorted[j + 1] = v;
+	}
+
+	return sorted[median->count / 2];
+}
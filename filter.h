@@ -0,0 +1,96 @@
+/******************************************************************************
+The filter.h in RaspberryPilot project is placed under the MIT license
+
+Copyright (c) 2016 jellyice1986 (Tung-Cheng Wu)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+******************************************************************************/
+
+#define FILTER_SMA_MAX_SIZE 256
+#define FILTER_MEDIAN_MAX_SIZE 9
+
+typedef enum {
+	FILTER_SMA,
+	FILTER_EMA,
+	FILTER_MEDIAN,
+	FILTER_BIQUAD,
+	FILTER_KALMAN_1D
+} FILTER_TYPE;
+
+typedef struct {
+	float b0;
+	float b1;
+	float b2;
+	float a1;
+	float a2;
+	float z1; // state of transposed direct form II
+	float z2;
+} BIQUAD_STRUCT;
+
+typedef struct {
+	float buf[FILTER_SMA_MAX_SIZE];
+	unsigned int size; // size of window
+	unsigned int index;
+	unsigned int count; // number of samples in window, it is less than size before window is filled
+	unsigned int pushes; // pushes since the running sum was recomputed
+	float sum; // running sum of window
+} SMA_STRUCT;
+
+typedef struct {
+	float alpha; // weight of new sample
+	bool isInitialized;
+} EMA_STRUCT;
+
+typedef struct {
+	float buf[FILTER_MEDIAN_MAX_SIZE];
+	unsigned char size;
+	unsigned char index;
+	unsigned char count;
+} MEDIAN_STRUCT;
+
+typedef struct {
+	char name[10]; // name of filter entity
+	FILTER_TYPE type;
+	float output; // latest output
+	union {
+		SMA_STRUCT sma;
+		EMA_STRUCT ema;
+		MEDIAN_STRUCT median;
+		BIQUAD_STRUCT biquad;
+		KALMAN_1D_STRUCT kalman;
+	} state;
+} FILTER_STRUCT;
+
+bool initSmaFilter(FILTER_STRUCT *filter, char *name, unsigned int size);
+void initEmaFilter(FILTER_STRUCT *filter, char *name, float alpha);
+bool initMedianFilter(FILTER_STRUCT *filter, char *name, unsigned char size);
+void initBiquadLowPassFilter(FILTER_STRUCT *filter, char *name,
+		float sampleRate, float cutoffFreq, float q);
+void initBiquadNotchFilter(FILTER_STRUCT *filter, char *name, float sampleRate,
+		float centerFreq, float q);
+void initKalmanFilter(FILTER_STRUCT *filter, char *name, float prevData,
+		float p, float q, float r, float kGain);
+float filterUpdate(FILTER_STRUCT *filter, float input);
+float getFilterOutput(FILTER_STRUCT *filter);
+void biquadSetLowPass(BIQUAD_STRUCT *biquad, float sampleRate,
+		float cutoffFreq, float q);
+void biquadSetNotch(BIQUAD_STRUCT *biquad, float sampleRate, float centerFreq,
+		float q);
+void biquadReset(BIQUAD_STRUCT *biquad);
+float biquadApply(BIQUAD_STRUCT *biquad, float input);
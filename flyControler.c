@@ -26,6 +26,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <float.h>
 #include <pthread.h>
 #include <wiringPi.h>
 #include <wiringSerial.h>
@@ -41,16 +42,17 @@
 #define DEFAULT_ADJUST_PERIOD 1
 #define DEFAULT_GYRO_LIMIT 50
 #define DEFAULT_ANGULAR_LIMIT 5000
+#define MAX_CONTROL_TIME_DIFF 0.1f // sec, a longer gap means the controlers were paused, skip that cycle
 
+static void updateControlTimeDiff(void);
 static void getAttitudePidOutput();
-static float getThrottleOffsetByAltHold(bool updateAltHoldOffset);
+static float getThrottleOffsetByAltHold(void);
 static float getThrottleOffsetByAcceleration(void);
 static void getAltHoldAltPidOutput();
 static void getAltHoldSpeedPidOutput(float *altHoldSpeedOutput);
 
-pthread_mutex_t controlMotorMutex;
-
 static bool leaveFlyControler;
+static bool haltPi;
 static float rollAttitudeOutput;
 static float pitchAttitudeOutput;
 static float yawAttitudeOutput;
@@ -61,6 +63,10 @@ static float gyroLimit;
 static float yawCenterPoint;
 static float maxThrottleOffset;
 static float altitudePidOutputLimitation;
+static struct timeval lastControlTv;
+static float controlTimeDiff;
+static PID_BANK_STRUCT attitudePidBank;
+static PID_BANK_STRUCT ratePidBank;
 
 /**
  * Init paramtes and states for flyControler
@@ -74,12 +80,8 @@ static float altitudePidOutputLimitation;
  */
 bool flyControlerInit() {
 
-	if (pthread_mutex_init(&controlMotorMutex, NULL) != 0) {
-		_ERROR("(%s-%d) controlMotorMutex init failed\n", __func__, __LINE__);
-		return false;
-	}
-
 	setLeaveFlyControlerFlag(false);
+	setHaltPiFlag(false);
 	disenableFlySystem();
 	setAdjustPeriod(DEFAULT_ADJUST_PERIOD);
 	setGyroLimit(DEFAULT_GYRO_LIMIT);
@@ -94,10 +96,45 @@ bool flyControlerInit() {
 	yawAttitudeOutput = 0.f;
 	altHoltAltOutput = 0.f;
 	maxThrottleOffset = 1000.f;
+	lastControlTv.tv_sec = 0;
+	lastControlTv.tv_usec = 0;
+	controlTimeDiff = 0.f;
+	pidBankInit(&attitudePidBank, &rollAttitudePidSettings,
+			&pitchAttitudePidSettings, &yawAttitudePidSettings);
+	pidBankInit(&ratePidBank, &rollRatePidSettings, &pitchRatePidSettings,
+			&yawRatePidSettings);
 
 	return true;
 }
 
+/**
+ * update the time difference shared by every PID controler in this control cycle,
+ * it is taken from the timestamps of IMU samples, so the clock is read once per cycle
+ * and all controlers of the cascade see the same sample instant
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		void
+ *
+ */
+void updateControlTimeDiff(void) {
+
+	struct timeval tv;
+
+	getAttitudeSampleTv(&tv);
+
+	controlTimeDiff =
+			TIME_IS_UPDATED(lastControlTv) ?
+					GET_SEC_TIMEDIFF(tv, lastControlTv) : 0.f;
+	if (controlTimeDiff > MAX_CONTROL_TIME_DIFF) {
+		controlTimeDiff = 0.f;
+	}
+
+	UPDATE_LAST_TIME(tv, lastControlTv);
+}
+
 /**
  * set a value to indicate whether the pilot is halting or not
  *
@@ -126,6 +163,34 @@ bool getLeaveFlyControlerFlag() {
 	return leaveFlyControler;
 }
 
+/**
+ * set a value to indicate whether Pi is halted after the pilot leaves
+ *
+ * @param v
+ * 		value
+ *
+ * @return
+ *		void
+ *
+ */
+void setHaltPiFlag(bool v) {
+	haltPi = v;
+}
+
+/**
+ * get the value to indicate whether Pi is halted after the pilot leaves
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		value
+ *
+ */
+bool getHaltPiFlag() {
+	return haltPi;
+}
+
 /**
  *  get the output of attitude PID controler, this output will become  a input for angular velocity PID controler
  *
@@ -138,17 +203,15 @@ bool getLeaveFlyControlerFlag() {
  */
 void getAttitudePidOutput() {
 
-	rollAttitudeOutput = LIMIT_MIN_MAX_VALUE(
-			pidCalculation(&rollAttitudePidSettings, getRoll(),true,true,true),
-			-getGyroLimit(), getGyroLimit());
-	pitchAttitudeOutput =
-			LIMIT_MIN_MAX_VALUE(
-					pidCalculation(&pitchAttitudePidSettings, getPitch(),true,true,true),
-					-getGyroLimit(), getGyroLimit());
-	yawAttitudeOutput =
-			LIMIT_MIN_MAX_VALUE(
-					pidCalculation(&yawAttitudePidSettings, yawTransform(getYaw()),true,true,true),
-					-getGyroLimit(), getGyroLimit());
+	PID_VECTOR processValue = { getRoll(), getPitch(), yawTransform(getYaw()),
+			0.f };
+	float output[PID_BANK_SIZE];
+
+	pidBankCalculation(&attitudePidBank, processValue, controlTimeDiff,
+			getGyroLimit(), output);
+	rollAttitudeOutput = output[PID_BANK_ROLL];
+	pitchAttitudeOutput = output[PID_BANK_PITCH];
+	yawAttitudeOutput = output[PID_BANK_YAW];
 
 	_DEBUG(DEBUG_ATTITUDE_PID_OUTPUT,
 			"(%s-%d) attitude pid output: roll=%.5f, pitch=%.5f, yaw=%.5f\n",
@@ -171,15 +234,19 @@ void getAttitudePidOutput() {
 void getRatePidOutput(float *rollRateOutput, float *pitchRateOutput,
 		float *yawRateOutput) {
 
+	PID_VECTOR processValue = { getRollGyro(), getPitchGyro(), getYawGyro(),
+			0.f };
+	float output[PID_BANK_SIZE];
+
 	setPidSp(&rollRatePidSettings, rollAttitudeOutput);
 	setPidSp(&pitchRatePidSettings, pitchAttitudeOutput);
 	setPidSp(&yawRatePidSettings, yawAttitudeOutput);
-	*rollRateOutput = pidCalculation(&rollRatePidSettings, getRollGyro(), true,
-	true, true);
-	*pitchRateOutput = pidCalculation(&pitchRatePidSettings, getPitchGyro(),
-	true, true, true);
-	*yawRateOutput = pidCalculation(&yawRatePidSettings, getYawGyro(), true,
-	true, true);
+	// rate outputs are limited after mixing, see motorControler
+	pidBankCalculation(&ratePidBank, processValue, controlTimeDiff, FLT_MAX,
+			output);
+	*rollRateOutput = output[PID_BANK_ROLL];
+	*pitchRateOutput = output[PID_BANK_PITCH];
+	*yawRateOutput = output[PID_BANK_YAW];
 
 	_DEBUG(DEBUG_RATE_PID_OUTPUT,
 			"(%s-%d) rate pid output: roll=%.5f, pitch=%.5f, yaw=%.5f\n",
@@ -229,7 +296,9 @@ void motorControler() {
 	float throttleOffset = 0.f;
 	float centerThrottle = 0.f;
 
-	altholdThrottleOffset = (getEnableAltHold() && getAltHoldIsReady()) ? getThrottleOffsetByAltHold(updateAltHold()) : 0.f;
+	updateControlTimeDiff();
+
+	altholdThrottleOffset = (getEnableAltHold() && getAltHoldIsReady()) ? getThrottleOffsetByAltHold() : 0.f;
 	accelThrottleOffset = getThrottleOffsetByAcceleration();
 	throttleOffset = altholdThrottleOffset + accelThrottleOffset;
 
@@ -319,10 +388,8 @@ void motorControler() {
 	outCw2 = getMotorGain(
 			SOFT_PWM_CW2) * LIMIT_MIN_MAX_VALUE(outCw2, minLimit, maxLimit);
 
-	setupCcw1MotorPoewrLevel((unsigned short) outCcw1);
-	setupCcw2MotorPoewrLevel((unsigned short) outCcw2);
-	setupCw1MotorPoewrLevel((unsigned short) outCw1);
-	setupCw2MotorPoewrLevel((unsigned short) outCw2);
+	setupAllMotorPoewrLevel((unsigned short) outCw1, (unsigned short) outCw2,
+			(unsigned short) outCcw1, (unsigned short) outCcw2);
 #if 0
 	_DEBUG(DEBUG_NORMAL,"outCcw1=%d,outCcw2=%d,outCw1=%d,outCw2=%d\n" ,
 		(unsigned short)outCcw1,
@@ -516,11 +583,13 @@ float getAltitudePidOutputLimitation(void) {
  */
 void getAltHoldAltPidOutput() {
 
-	altHoltAltOutput =
-			LIMIT_MIN_MAX_VALUE(
-					pidCalculation(&altHoldAltSettings, getCurrentAltHoldAltitude()-getTargetAlt(),true,true,true),
-					-getAltitudePidOutputLimitation(),
-					getAltitudePidOutputLimitation());
+	// evaluate once, LIMIT_MIN_MAX_VALUE expands its value more than once
+	altHoltAltOutput = pidCalculation(&altHoldAltSettings,
+			getCurrentAltHoldAltitude() - getTargetAlt(), controlTimeDiff, true,
+			true, true);
+	altHoltAltOutput = LIMIT_MIN_MAX_VALUE(altHoltAltOutput,
+			-getAltitudePidOutputLimitation(),
+			getAltitudePidOutputLimitation());
 	
 	//_DEBUG(DEBUG_NORMAL,"getPidSp(&altHoldAltSettings)=%f\n",getPidSp(&altHoldAltSettings));
 	//_DEBUG(DEBUG_NORMAL,"getCurrentAltHoldAltitude=%f,getTargetAlt=%f\n",getCurrentAltHoldAltitude(),getTargetAlt());
@@ -540,7 +609,7 @@ void getAltHoldSpeedPidOutput(float *altHoldSpeedOutput) {
 
 	setPidSp(&altHoldlSpeedSettings, altHoltAltOutput);
 	*altHoldSpeedOutput = pidCalculation(&altHoldlSpeedSettings,
-			getAltholdSpeed(),true,true,true);
+			getAltholdSpeed(),controlTimeDiff,true,true,true);
 	//_DEBUG(DEBUG_NORMAL,"getAltholdSpeed=%f\n",getAltholdSpeed());
 	//_DEBUG(DEBUG_NORMAL,"altHoldSpeedOutput=%f, altHoltAltOutput=%f\n",*altHoldSpeedOutput, altHoltAltOutput);
 }
@@ -554,19 +623,15 @@ void getAltHoldSpeedPidOutput(float *altHoldSpeedOutput) {
  * @return
  *		void
  */
-float getThrottleOffsetByAltHold(bool updateAltHoldOffset) {
+float getThrottleOffsetByAltHold(void) {
 
 	float output = 0.f;
 
-	if (updateAltHoldOffset) {
+	getAltHoldAltPidOutput();
+	getAltHoldSpeedPidOutput(&output);
+	output = LIMIT_MIN_MAX_VALUE(output, -maxThrottleOffset,
+			maxThrottleOffset);
 
-		getAltHoldAltPidOutput();
-		getAltHoldSpeedPidOutput(&output);
-		output = LIMIT_MIN_MAX_VALUE(output, -maxThrottleOffset,
-				maxThrottleOffset);
-		
-	}
-	
 	//_DEBUG(DEBUG_NORMAL,"output =%f\n",output);
 
 	return output;
@@ -587,9 +652,9 @@ float getThrottleOffsetByAcceleration(void) {
 
 	setPidSp(&verticalAccelPidSettings, 0.f);
 	
-	output = LIMIT_MIN_MAX_VALUE(pidCalculation(&verticalAccelPidSettings,
-			getVerticalAcceleration(),true,true,true), -maxThrottleOffset,
-		maxThrottleOffset);
+	output = pidCalculation(&verticalAccelPidSettings,
+			getVerticalAcceleration(), controlTimeDiff, true, true, true);
+	output = LIMIT_MIN_MAX_VALUE(output, -maxThrottleOffset, maxThrottleOffset);
 	
 	//_DEBUG(DEBUG_NORMAL,"%s output =%f\n",__func__,output);
 	return output;
@@ -21,10 +21,10 @@
  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
  SOFTWARE.
  ******************************************************************************/
-extern pthread_mutex_t controlMotorMutex;
-
 void setLeaveFlyControlerFlag(bool v);
 bool getLeaveFlyControlerFlag();
+void setHaltPiFlag(bool v);
+bool getHaltPiFlag();
 bool flyControlerInit();
 void motorControler();
 void setYawCenterPoint(float point);
@@ -39,40 +39,144 @@
 #include <stdlib.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <linux/i2c.h>
 #include <linux/i2c-dev.h>
 #include <sys/ioctl.h>
 #include <memory.h>
 #include <errno.h>
+#include <pthread.h>
 #include "commonLib.h"
 #include "i2c.h"
 
+typedef struct {
+	int fd;
+	int slaveAddr;
+	pthread_mutex_t mutex;
+	unsigned long transactions; // number of transfers issued on the bus, one ioctl or read/write is one transaction
+} I2C_BUS_STRUCT;
+
+static I2C_BUS_STRUCT i2cBus = { -1, -1, PTHREAD_MUTEX_INITIALIZER, 0 };
+
+static bool i2cOpenBus(void);
+static bool i2cAcquireBus(unsigned char devAddr);
+static void i2cReleaseBus(bool transferIsOk);
+static bool i2cTransfer(struct i2c_msg *msgs, unsigned char count);
+
 /**
- * check whather a I2C devide is existing or not
+ * open the bus if it is not opened yet, the caller must hold the bus lock
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		success or failure
+ *
+ */
+static bool i2cOpenBus(void) {
+
+	if (i2cBus.fd < 0) {
+		i2cBus.fd = open(I2C_DEV_PATH, O_RDWR);
+		if (i2cBus.fd < 0) {
+			_ERROR("%s: Failed to open device\n", __func__);
+			return false;
+		}
+		i2cBus.slaveAddr = -1;
+	}
+
+	return true;
+}
+
+/**
+ * lock the bus, open it if necessary and select the slave device,
+ * the file descriptor is kept open between transfers and I2C_SLAVE is only issued when the slave address changes
  *
  * @param devAddr
  * 		i2c address of device
  *
  * @return
- *		bool
+ *		success or failure, the bus is unlocked if failure
  *
  */
-bool checkI2cDeviceIsExist(unsigned char devAddr) {
+static bool i2cAcquireBus(unsigned char devAddr) {
 
-	int fd = -1;
-	bool result = true;
-	unsigned char regAddr = 0x01;
+	pthread_mutex_lock(&i2cBus.mutex);
 
-	fd = open(I2C_DEV_PATH, O_RDWR);
+	if (!i2cOpenBus()) {
+		goto Fail;
+	}
 
-	if (fd < 0) {
-		result = false;
-		goto Exit;
+	if (i2cBus.slaveAddr != devAddr) {
+		if (ioctl(i2cBus.fd, I2C_SLAVE, devAddr) < 0) {
+			_ERROR("%s: Failed to select device 0x%x\n", __func__, devAddr);
+			goto Fail;
+		}
+		i2cBus.slaveAddr = devAddr;
+	}
+
+	return true;
+
+	Fail:
+	i2cReleaseBus(false);
+	return false;
+}
+
+/**
+ * unlock the bus, the file descriptor is closed if the transfer failed, so it will be reopened by next transfer
+ *
+ * @param transferIsOk
+ * 		whether the transfer is successful or not
+ *
+ * @return
+ *		void
+ *
+ */
+static void i2cReleaseBus(bool transferIsOk) {
+
+	if (!transferIsOk && i2cBus.fd >= 0) {
+		close(i2cBus.fd);
+		i2cBus.fd = -1;
+		i2cBus.slaveAddr = -1;
+	}
+
+	pthread_mutex_unlock(&i2cBus.mutex);
+}
+
+/**
+ * submit several messages in one I2C_RDWR ioctl, the messages are separated by repeated start and only one STOP is issued at the end
+ *
+ * @param msgs
+ * 		messages, every message carries its own slave address
+ *
+ * @param count
+ * 		number of messages
+ *
+ * @return
+ *		success or failure
+ *
+ */
+static bool i2cTransfer(struct i2c_msg *msgs, unsigned char count) {
+
+	struct i2c_rdwr_ioctl_data packets;
+	bool result = true;
+
+	if (count > I2C_RDWR_IOCTL_MAX_MSGS) {
+		_ERROR("%s: count (%d) > %d\n", __func__, count,
+				I2C_RDWR_IOCTL_MAX_MSGS);
+		return false;
 	}
-	if (ioctl(fd, I2C_SLAVE, devAddr) < 0) {
+
+	pthread_mutex_lock(&i2cBus.mutex);
+
+	if (!i2cOpenBus()) {
 		result = false;
 		goto Exit;
 	}
-	if (write(fd, &regAddr, 1) != 1) {
+
+	packets.msgs = msgs;
+	packets.nmsgs = count;
+	i2cBus.transactions++;
+	if (ioctl(i2cBus.fd, I2C_RDWR, &packets) != count) {
+		_ERROR("%s: Failed to transfer %d messages\n", __func__, count);
 		result = false;
 		goto Exit;
 	}
@@ -80,7 +184,35 @@ bool checkI2cDeviceIsExist(unsigned char devAddr) {
 	goto Exit;
 
 	Exit:
-	close(fd);
+	i2cReleaseBus(result);
+	return result;
+}
+
+/**
+ * check whather a I2C devide is existing or not
+ *
+ * @param devAddr
+ * 		i2c address of device
+ *
+ * @return
+ *		bool
+ *
+ */
+bool checkI2cDeviceIsExist(unsigned char devAddr) {
+
+	bool result = true;
+	unsigned char regAddr = 0x01;
+
+	if (!i2cAcquireBus(devAddr)) {
+		return false;
+	}
+
+	i2cBus.transactions++;
+	if (write(i2cBus.fd, &regAddr, 1) != 1) {
+		result = false;
+	}
+
+	i2cReleaseBus(result);
 	return result;
 }
 
@@ -199,30 +331,21 @@ bool writeBytes(unsigned char devAddr, unsigned char regAddr,
 
 	char count = 0;
 	unsigned char buf[128];
-	int fd;
 	bool result = true;
 
 	if (length > 127) {
 		_ERROR("length (%d) > 127\n", length);
-		result = false;
-		goto Exit;
+		return false;
 	}
 
-	fd = open(I2C_DEV_PATH, O_RDWR);
-	if (fd < 0) {
-		_ERROR("%s: Failed to open device\n", __func__);
-		result = false;
-		goto Exit;
-	}
-	if (ioctl(fd, I2C_SLAVE, devAddr) < 0) {
-		_ERROR("%s: Failed to select device\n", __func__);
-		result = false;
-		goto Exit;
+	if (!i2cAcquireBus(devAddr)) {
+		return false;
 	}
 
 	buf[0] = regAddr;
 	memcpy(buf + 1, data, length);
-	count = write(fd, buf, length + 1);
+	i2cBus.transactions++;
+	count = write(i2cBus.fd, buf, length + 1);
 	if (count < 0) {
 		_ERROR("%s Failed to write device(%d)\n", __func__, count);
 		result = false;
@@ -237,10 +360,90 @@ bool writeBytes(unsigned char devAddr, unsigned char regAddr,
 	goto Exit;
 
 	Exit:
-	close(fd);
+	i2cReleaseBus(result);
 	return result;
 }
 
+/**
+ * write several register blocks in one I2C_RDWR ioctl, every block is a register address followed by its data,
+ * the blocks are separated by repeated start and only one STOP is issued for the whole batch
+ *
+ * @param requests
+ * 		device address, register address, length and source of each block
+ *
+ * @param count
+ * 		number of blocks, up to I2C_WRITE_BATCH_MAX
+ *
+ * @return
+ *		success or failure
+ *
+ */
+bool writeBytesBatch(I2C_WRITE_REQUEST_STRUCT *requests, unsigned char count) {
+	return writeBytesBatchThenRead(requests, count, NULL);
+}
+
+/**
+ * write several register blocks and then read a register block in one I2C_RDWR ioctl,
+ * so the writes which a read depends on cost no extra transaction
+ *
+ * @param requests
+ * 		device address, register address, length and source of each block
+ *
+ * @param count
+ * 		number of blocks, up to I2C_WRITE_BATCH_MAX, or I2C_WRITE_BATCH_MAX-2 if read is not NULL
+ *
+ * @param read
+ * 		device address, register address, length and destination of the block to read, or NULL
+ *
+ * @return
+ *		success or failure
+ *
+ */
+bool writeBytesBatchThenRead(I2C_WRITE_REQUEST_STRUCT *requests,
+		unsigned char count, I2C_READ_REQUEST_STRUCT *read) {
+
+	struct i2c_msg msgs[I2C_WRITE_BATCH_MAX];
+	unsigned char buf[I2C_WRITE_BATCH_BUF_SIZE];
+	unsigned short offset = 0;
+	unsigned char msgCount = count + ((NULL == read) ? 0 : 2);
+	unsigned char i;
+
+	if (msgCount > I2C_WRITE_BATCH_MAX) {
+		_ERROR("%s: count (%d) > %d\n", __func__, msgCount, I2C_WRITE_BATCH_MAX);
+		return false;
+	}
+
+	for (i = 0; i < count; i++) {
+
+		if (offset + requests[i].length + 1 > sizeof(buf)) {
+			_ERROR("%s: batch is larger than %d bytes\n", __func__,
+					I2C_WRITE_BATCH_BUF_SIZE);
+			return false;
+		}
+
+		buf[offset] = requests[i].regAddr;
+		memcpy(buf + offset + 1, requests[i].data, requests[i].length);
+		msgs[i].addr = requests[i].devAddr;
+		msgs[i].flags = 0;
+		msgs[i].len = requests[i].length + 1;
+		msgs[i].buf = buf + offset;
+		offset += requests[i].length + 1;
+	}
+
+	if (NULL != read) {
+		msgs[count].addr = read->devAddr;
+		msgs[count].flags = 0;
+		msgs[count].len = 1;
+		msgs[count].buf = &read->regAddr;
+		msgs[count + 1].addr = read->devAddr;
+		msgs[count + 1].flags = I2C_M_RD;
+		msgs[count + 1].len = read->length;
+		msgs[count + 1].buf = read->data;
+	}
+
+	return i2cTransfer(msgs, msgCount);
+}
+
 /**
  * write a word into the register on a i2c device
  *
@@ -287,32 +490,25 @@ bool writeWords(unsigned char devAddr, unsigned char regAddr,
 	char count = 0;
 	unsigned char buf[128];
 	int i;
-	int fd;
 	bool result = true;
 
 	if (length > 63) {
 		_ERROR("%s: length (%d) > 63\n", __func__, length);
-		result = false;
-		goto Exit;
+		return false;
 	}
 
-	fd = open(I2C_DEV_PATH, O_RDWR);
-	if (fd < 0) {
-		_ERROR("%s: Failed to open device\n", __func__);
-		result = false;
-		goto Exit;
-	}
-	if (ioctl(fd, I2C_SLAVE, devAddr) < 0) {
-		_ERROR("%s: Failed to select device\n", __func__);
-		result = false;
-		goto Exit;
-	}
 	buf[0] = regAddr;
 	for (i = 0; i < length; i++) {
 		buf[i * 2 + 1] = data[i] >> 8;
 		buf[i * 2 + 2] = data[i];
 	}
-	count = write(fd, buf, length * 2 + 1);
+
+	if (!i2cAcquireBus(devAddr)) {
+		return false;
+	}
+
+	i2cBus.transactions++;
+	count = write(i2cBus.fd, buf, length * 2 + 1);
 	if (count < 0) {
 		_ERROR("%s: Failed to write device(%d)\n", __func__, count);
 		result = false;
@@ -327,7 +523,7 @@ bool writeWords(unsigned char devAddr, unsigned char regAddr,
 	goto Exit;
 
 	Exit:
-	close(fd);
+	i2cReleaseBus(result);
 	return result;
 }
 
@@ -373,40 +569,56 @@ char readByte(unsigned char devAddr, unsigned char regAddr, unsigned char *data)
 char readBytes(unsigned char devAddr, unsigned char regAddr,
 		unsigned char length, unsigned char *data) {
 
-	char count = 0;
-	int fd = open(I2C_DEV_PATH, O_RDWR);
+	I2C_READ_REQUEST_STRUCT request;
 
-	if (fd < 0) {
-		_ERROR("Failed to open device: \n");
-		count = -1;
-		goto Exit;
-	}
-	if (ioctl(fd, I2C_SLAVE, devAddr) < 0) {
-		_ERROR("Failed to select device: \n");
-		count = -1;
-		goto Exit;
-	}
-	if (write(fd, &regAddr, 1) != 1) {
-		_ERROR("Failed to write reg: \n");
-		count = -1;
-		goto Exit;
+	request.devAddr = devAddr;
+	request.regAddr = regAddr;
+	request.length = length;
+	request.data = data;
+
+	if (!readBytesBatch(&request, 1)) {
+		return -1;
 	}
-	count = read(fd, data, length);
-	if (count < 0) {
-		_ERROR("Failed to read device(%d): \n", count);
-		count = -1;
-		goto Exit;
-	} else if (count != length) {
-		_ERROR("Short read  from device, expected %d, got %d\n", length, count);
-		count = -1;
-		goto Exit;
+
+	return length;
+}
+
+/**
+ * read several register blocks in one I2C_RDWR ioctl, every block is a register address write followed by a repeated start read,
+ * so no other transfer can slip in between and only one STOP is issued for the whole batch
+ *
+ * @param requests
+ * 		device address, register address, length and destination of each block
+ *
+ * @param count
+ * 		number of blocks, up to I2C_READ_BATCH_MAX
+ *
+ * @return
+ *		success or failure
+ *
+ */
+bool readBytesBatch(I2C_READ_REQUEST_STRUCT *requests, unsigned char count) {
+
+	struct i2c_msg msgs[I2C_READ_BATCH_MAX * 2];
+	unsigned char i;
+
+	if (count > I2C_READ_BATCH_MAX) {
+		_ERROR("%s: count (%d) > %d\n", __func__, count, I2C_READ_BATCH_MAX);
+		return false;
 	}
 
-	goto Exit;
+	for (i = 0; i < count; i++) {
+		msgs[i * 2].addr = requests[i].devAddr;
+		msgs[i * 2].flags = 0;
+		msgs[i * 2].len = 1;
+		msgs[i * 2].buf = &requests[i].regAddr;
+		msgs[i * 2 + 1].addr = requests[i].devAddr;
+		msgs[i * 2 + 1].flags = I2C_M_RD;
+		msgs[i * 2 + 1].len = requests[i].length;
+		msgs[i * 2 + 1].buf = requests[i].data;
+	}
 
-	Exit:
-	close(fd);
-	return count;
+	return i2cTransfer(msgs, count * 2);
 }
 
 /**
@@ -475,3 +687,33 @@ char readBit(unsigned char devAddr, unsigned char regAddr, unsigned char bitNum,
 	return count;
 }
 
+/**
+ * get number of transactions issued on the bus
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		number of transactions
+ *
+ */
+unsigned long getI2cTransactionCount() {
+	return i2cBus.transactions;
+}
+
+/**
+ * reset number of transactions issued on the bus
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		void
+ *
+ */
+void resetI2cTransactionCount() {
+
+	pthread_mutex_lock(&i2cBus.mutex);
+	i2cBus.transactions = 0;
+	pthread_mutex_unlock(&i2cBus.mutex);
+}
@@ -36,6 +36,23 @@
  ******************************************************************************/
 
 #define I2C_DEV_PATH "/dev/i2c-1"
+#define I2C_READ_BATCH_MAX 21
+#define I2C_WRITE_BATCH_MAX 42
+#define I2C_WRITE_BATCH_BUF_SIZE 256
+
+typedef struct {
+	unsigned char devAddr;
+	unsigned char regAddr;
+	unsigned char length;
+	unsigned char *data;
+} I2C_READ_REQUEST_STRUCT;
+
+typedef struct {
+	unsigned char devAddr;
+	unsigned char regAddr;
+	unsigned char length;
+	unsigned char *data;
+} I2C_WRITE_REQUEST_STRUCT;
 
 bool checkI2cDeviceIsExist(unsigned char devAddr);
 bool writeByte(unsigned char devAddr, unsigned char regAddr,
@@ -50,12 +67,18 @@ bool writeWord(unsigned char devAddr, unsigned char regAddr,
 		unsigned short data);
 bool writeWords(unsigned char devAddr, unsigned char regAddr,
 		unsigned char length, unsigned short* data);
+bool writeBytesBatch(I2C_WRITE_REQUEST_STRUCT *requests, unsigned char count);
+bool writeBytesBatchThenRead(I2C_WRITE_REQUEST_STRUCT *requests,
+		unsigned char count, I2C_READ_REQUEST_STRUCT *read);
 char readByte(unsigned char devAddr, unsigned char regAddr,
 		unsigned char *data);
 char readBytes(unsigned char devAddr, unsigned char regAddr,
 		unsigned char length, unsigned char *data);
+bool readBytesBatch(I2C_READ_REQUEST_STRUCT *requests, unsigned char count);
 char readBit(unsigned char devAddr, unsigned char regAddr, unsigned char bitNum,
 		unsigned char *data);
 char readBits(unsigned char devAddr, unsigned char regAddr,
 		unsigned char bitStart, unsigned char length, unsigned char *data);
+unsigned long getI2cTransactionCount();
+void resetI2cTransactionCount();
 
@@ -56,7 +56,6 @@ static unsigned short escMinThrottle;
  */
 void motorInit() {
 
-	pthread_mutex_lock(&controlMotorMutex);
 	resetPca9685();
 	pca9685SetPwmFreq((unsigned short)ESC_UPDATE_RATE);
 	escMaxThrottle = (unsigned short)(4096.f *((float)ESC_UPDATE_RATE/ESC_MAX_THROTTLE_HZ));
@@ -67,7 +66,6 @@ void motorInit() {
 	setThrottlePowerLevel(getMinPowerLevel() );
 	setupAllMotorPoewrLevel(getMinPowerLevel() , getMinPowerLevel() , getMinPowerLevel() ,
 	getMinPowerLevel() );
-	pthread_mutex_unlock(&controlMotorMutex);
 
 }
 
@@ -90,10 +88,22 @@ void motorInit() {
 void setupAllMotorPoewrLevel(unsigned short CW1, unsigned short CW2,
 		unsigned short CCW1, unsigned short CCW2) {
 
-	setupCcw1MotorPoewrLevel(CCW1);
-	setupCcw2MotorPoewrLevel(CCW2);
-	setupCw1MotorPoewrLevel(CW1);
-	setupCw2MotorPoewrLevel(CW2);
+	unsigned char channels[4] = { SOFT_PWM_CCW1, SOFT_PWM_CCW2, SOFT_PWM_CW1,
+			SOFT_PWM_CW2 };
+	unsigned short values[4];
+
+	motorPowerLevel_CCW1 = LIMIT_MIN_MAX_VALUE(CCW1, 0, getMaxPowerLeve());
+	motorPowerLevel_CCW2 = LIMIT_MIN_MAX_VALUE(CCW2, 0, getMaxPowerLeve());
+	motorPowerLevel_CW1 = LIMIT_MIN_MAX_VALUE(CW1, 0, getMaxPowerLeve());
+	motorPowerLevel_CW2 = LIMIT_MIN_MAX_VALUE(CW2, 0, getMaxPowerLeve());
+
+	values[0] = motorPowerLevel_CCW1;
+	values[1] = motorPowerLevel_CCW2;
+	values[2] = motorPowerLevel_CW1;
+	values[3] = motorPowerLevel_CW2;
+
+	// all motors are updated together in one I2C transaction
+	pca9685SetPwmMulti(channels, values, 4);
 }
 
 /**
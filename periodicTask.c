@@ -0,0 +1,226 @@
+/******************************************************************************
+The periodicTask.c in RaspberryPilot project is placed under the MIT license
+
+Copyright (c) 2016 jellyice1986 (Tung-Cheng Wu)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include "commonLib.h"
+#include "periodicTask.h"
+
+static void addUsecToTimespec(struct timespec *ts, unsigned long usec);
+static long long getTimespecUsecDiff(struct timespec *a, struct timespec *b);
+
+/**
+ * init a periodic task, the first cycle is released one period after now
+ *
+ * @param task
+ * 		periodic task
+ *
+ * @param name
+ * 		name of task
+ *
+ * @param period
+ * 		period (us)
+ *
+ * @param policy
+ * 		how to handle the cycles which are missed by an overrun
+ *
+ * @return
+ *		void
+ *
+ */
+void periodicTaskInit(PERIODIC_TASK_STRUCT *task, char *name,
+		unsigned long period, PERIODIC_TASK_POLICY policy) {
+
+	memset(task, 0, sizeof(PERIODIC_TASK_STRUCT));
+	strncpy(task->name, name, sizeof(task->name) - 1);
+	task->period = period;
+	task->policy = policy;
+	clock_gettime(CLOCK_MONOTONIC, &task->deadline);
+}
+
+/**
+ * change the period, it takes effect from the next release
+ *
+ * @param task
+ * 		periodic task
+ *
+ * @param period
+ * 		period (us)
+ *
+ * @return
+ *		void
+ *
+ */
+void periodicTaskSetPeriod(PERIODIC_TASK_STRUCT *task, unsigned long period) {
+	task->period = period;
+}
+
+/**
+ * get the period
+ *
+ * @param task
+ * 		periodic task
+ *
+ * @return
+ *		period (us)
+ *
+ */
+unsigned long periodicTaskGetPeriod(PERIODIC_TASK_STRUCT *task) {
+	return task->period;
+}
+
+/**
+ * sleep until the next release of a periodic task,
+ * the release times are absolute, so the period does not drift with the execution time of a cycle
+ * and is not affected by the change of wall clock
+ *
+ * @param task
+ * 		periodic task
+ *
+ * @return
+ *		number of cycles dropped by this call
+ *
+ */
+unsigned long periodicTaskWait(PERIODIC_TASK_STRUCT *task) {
+
+	struct timespec now;
+	long long lateness;
+	unsigned long behind;
+	unsigned long dropped = 0;
+
+	addUsecToTimespec(&task->deadline, task->period);
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	lateness = getTimespecUsecDiff(&now, &task->deadline);
+
+	if (lateness >= 0) {
+
+		// the previous cycle overran, this release is already due
+		task->overruns++;
+		behind = (unsigned long) lateness / task->period;
+
+		if (task->policy == PERIODIC_TASK_CATCH_UP) {
+			dropped = (behind > PERIODIC_TASK_MAX_CATCH_UP) ?
+					(behind - PERIODIC_TASK_MAX_CATCH_UP) : 0;
+		} else {
+			dropped = behind;
+		}
+
+		addUsecToTimespec(&task->deadline, dropped * task->period);
+		task->droppedCycles += dropped;
+
+		return dropped;
+	}
+
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &task->deadline,
+			NULL) == EINTR)
+		;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	lateness = getTimespecUsecDiff(&now, &task->deadline);
+	if (lateness > (long long) task->maxWakeupLatency) {
+		task->maxWakeupLatency = (unsigned long) lateness;
+	}
+
+	return 0;
+}
+
+/**
+ * print the statistics of a periodic task
+ *
+ * @param task
+ * 		periodic task
+ *
+ * @return
+ *		void
+ *
+ */
+void periodicTaskPrintStatistics(PERIODIC_TASK_STRUCT *task) {
+
+	_DEBUG(DEBUG_NORMAL,
+			"%s: period=%ld us, overruns=%ld, dropped=%ld, max wakeup latency=%ld us\n",
+			task->name, task->period, task->overruns, task->droppedCycles,
+			task->maxWakeupLatency);
+}
+
+/**
+ * reset the statistics of a periodic task
+ *
+ * @param task
+ * 		periodic task
+ *
+ * @return
+ *		void
+ *
+ */
+void periodicTaskResetStatistics(PERIODIC_TASK_STRUCT *task) {
+
+	task->overruns = 0;
+	task->droppedCycles = 0;
+	task->maxWakeupLatency = 0;
+}
+
+/**
+ * add microseconds to a timespec
+ *
+ * @param ts
+ * 		timespec
+ *
+ * @param usec
+ * 		microseconds
+ *
+ * @return
+ *		void
+ *
+ */
+static void addUsecToTimespec(struct timespec *ts, unsigned long usec) {
+
+	ts->tv_sec += usec / 1000000;
+	ts->tv_nsec += (usec % 1000000) * 1000;
+
+	if (ts->tv_nsec >= 1000000000) {
+		ts->tv_sec += 1;
+		ts->tv_nsec -= 1000000000;
+	}
+}
+
+/**
+ * get a-b in microseconds
+ *
+ * @param a
+ * 		timespec
+ *
+ * @param b
+ * 		timespec
+ *
+ * @return
+ *		difference (us)
+ *
+ */
+static long long getTimespecUsecDiff(struct timespec *a, struct timespec *b) {
+
+	return ((long long) (a->tv_sec - b->tv_sec)) * 1000000
+			+ (a->tv_nsec - b->tv_nsec) / 1000;
+}
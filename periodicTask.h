@@ -0,0 +1,48 @@
+/******************************************************************************
+The periodicTask.h in RaspberryPilot project is placed under the MIT license
+
+Copyright (c) 2016 jellyice1986 (Tung-Cheng Wu)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+******************************************************************************/
+
+#define PERIODIC_TASK_MAX_CATCH_UP 3
+
+typedef enum {
+	PERIODIC_TASK_SKIP, // run one late cycle at once and drop the other missed cycles
+	PERIODIC_TASK_CATCH_UP // run missed cycles back to back, at most PERIODIC_TASK_MAX_CATCH_UP cycles
+} PERIODIC_TASK_POLICY;
+
+typedef struct {
+	char name[20];
+	unsigned long period; // us
+	PERIODIC_TASK_POLICY policy;
+	struct timespec deadline; // absolute release time of the current cycle on CLOCK_MONOTONIC
+	unsigned long overruns; // cycles which did not finish before the next release
+	unsigned long droppedCycles;
+	unsigned long maxWakeupLatency; // us
+} PERIODIC_TASK_STRUCT;
+
+void periodicTaskInit(PERIODIC_TASK_STRUCT *task, char *name,
+		unsigned long period, PERIODIC_TASK_POLICY policy);
+void periodicTaskSetPeriod(PERIODIC_TASK_STRUCT *task, unsigned long period);
+unsigned long periodicTaskGetPeriod(PERIODIC_TASK_STRUCT *task);
+unsigned long periodicTaskWait(PERIODIC_TASK_STRUCT *task);
+void periodicTaskPrintStatistics(PERIODIC_TASK_STRUCT *task);
+void periodicTaskResetStatistics(PERIODIC_TASK_STRUCT *task);
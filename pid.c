@@ -29,6 +29,16 @@
 #include "commonLib.h"
 #include "pid.h"
 
+#define PID_PI 3.14159265358979f
+
+/**
+ * a setting or record of a pid entity, it is the lane of the bank when the entity is bound to one
+ */
+#define PID_LANE(pid, field) (*((pid)->bank ? &(pid)->bank->field[(pid)->lane] : &(pid)->field))
+
+static float getDerivativeFilterRc(float cutoffFreq);
+static float getDerivativeFilterAlpha(float cutoffFreq, float dt);
+
 /**
  *	Default PID parameter for attitude
  */
@@ -211,7 +221,44 @@ void pidInit() {
 }
 
 /**
- * PID conrroler
+ * get the time constant of the first-order low-pass on D term
+ *
+ * @param cutoffFreq
+ *		cutoff frequency (Hz), the filter is bypassed if it is not positive
+ *
+ * @return
+ *		time constant (sec), 0 if the filter is bypassed
+ *
+ */
+static float getDerivativeFilterRc(float cutoffFreq) {
+
+	if (cutoffFreq <= 0.f) {
+		return 0.f;
+	}
+
+	return 1.f / (2.f * PID_PI * cutoffFreq);
+}
+
+/**
+ * get the weight of a new sample of the first-order low-pass on D term,
+ * it is derived from dt, so the cutoff frequency holds when the control rate changes
+ *
+ * @param cutoffFreq
+ *		cutoff frequency (Hz), the filter is bypassed if it is not positive
+ *
+ * @param dt
+ *		time since the previous sample (sec)
+ *
+ * @return
+ *		weight of new sample
+ *
+ */
+static float getDerivativeFilterAlpha(float cutoffFreq, float dt) {
+	return dt / (dt + getDerivativeFilterRc(cutoffFreq));
+}
+
+/**
+ * PID conrroler of an entity which is not bound to a PID bank
  *
  * @param pid
  *		 pid entity
@@ -219,28 +266,32 @@ void pidInit() {
  * @param processValue
  *		input of PID controler
  *
+ * @param dt
+ *		time since the previous sample (sec), the caller reads the clock once per control cycle
+ *		and passes the same value to every PID controler of the cascade,
+ *		a calculation with dt<=0 is skipped and the previous output is held
+ *
  * @return
  *		output of PID controler
  *
  */
-float pidCalculation(PID_STRUCT *pid, float processValue, bool outputP,
-		bool outputI, bool outputD) {
+float pidCalculation(PID_STRUCT *pid, float processValue, float dt,
+		bool outputP, bool outputI, bool outputD) {
 
 	float pterm = 0.f;
 	float dterm = 0.f;
 	float iterm = 0.f;
 	float result = 0.f;
-	float timeDiff = 0.f;
-	struct timeval tv;
+	float timeDiff = dt;
 
-	gettimeofday(&tv, NULL);
+	if (timeDiff <= 0.f) {
+		return pid->output;
+	}
 
-	if (TIME_IS_UPDATED(pid->last_tv)) {
+	if (pid->isStarted) {
 
 		pid->pv = processValue;
 
-		timeDiff = GET_SEC_TIMEDIFF(tv, pid->last_tv);
-
 		//P term
 		if (outputP) {
 			pid->err = deadband((pid->sp + pid->spShift) - (pid->pv),
@@ -258,12 +309,18 @@ float pidCalculation(PID_STRUCT *pid, float processValue, bool outputP,
 
 		//D term
 		if (outputD) {
-			dterm = (pid->err - pid->last_error) / NON_ZERO(timeDiff);
-			dterm = pid->dgain * dterm;
+			dterm = pid->dOnMeasurement ?
+					-(pid->pv - pid->lastPv) / NON_ZERO(timeDiff) :
+					(pid->err - pid->last_error) / NON_ZERO(timeDiff);
+			pid->dFiltered += getDerivativeFilterAlpha(pid->dCutoffFreq,
+					timeDiff) * (dterm - pid->dFiltered);
+			dterm = pid->dgain * pid->dFiltered;
 			pid->last_error = pid->err;
 		}
 
-		result = (pterm + iterm + dterm);
+		//feed-forward term
+		result = (pterm + iterm + dterm)
+				+ pid->ffGain * (pid->sp + pid->spShift);
 
 #if 0 //Debug
 		if(0==strncmp(pid->name,"ROLL_R",strlen("ROLL_R"))) {
@@ -283,11 +340,213 @@ float pidCalculation(PID_STRUCT *pid, float processValue, bool outputP,
 #endif
 	}
 
-	UPDATE_LAST_TIME(tv, pid->last_tv);
+	pid->lastPv = processValue;
+	pid->isStarted = true;
+	pid->output = result;
 
 	return result;
 }
 
+/**
+ * select elements from a or b by mask
+ *
+ * @param mask
+ *		lanes whose mask is set take a, others take b
+ *
+ * @param a
+ *		vector
+ *
+ * @param b
+ *		vector
+ *
+ * @return
+ *		selected vector
+ *
+ */
+static inline PID_VECTOR pidVectorSelect(PID_VECTOR_MASK mask, PID_VECTOR a,
+		PID_VECTOR b) {
+	return (PID_VECTOR) (((PID_VECTOR_MASK) a & mask)
+			| ((PID_VECTOR_MASK) b & ~mask));
+}
+
+/**
+ * limit every element of a vector in [-limit, limit]
+ *
+ * @param value
+ *		vector
+ *
+ * @param limit
+ *		limitation of each element
+ *
+ * @return
+ *		limited vector
+ *
+ */
+static inline PID_VECTOR pidVectorLimit(PID_VECTOR value, PID_VECTOR limit) {
+	value = pidVectorSelect(value > limit, limit, value);
+	return pidVectorSelect(value < -limit, -limit, value);
+}
+
+/**
+ * dead band of every element of a vector, the same as deadband() in commonLib
+ *
+ * @param value
+ *		vector
+ *
+ * @param threshold
+ *		threshold of each element
+ *
+ * @return
+ *		vector
+ *
+ */
+static inline PID_VECTOR pidVectorDeadband(PID_VECTOR value,
+		PID_VECTOR threshold) {
+
+	PID_VECTOR zero = { 0.f, 0.f, 0.f, 0.f };
+
+	return pidVectorSelect(value > threshold, value - threshold,
+			pidVectorSelect(value < -threshold, value + threshold, zero));
+}
+
+/**
+ * bind roll, pitch and yaw PID entities to a PID bank, their settings and records are moved
+ * into the lanes of the bank, and their accessors work on the lanes from now on
+ *
+ * @param bank
+ *		PID bank
+ *
+ * @param roll
+ *		roll PID entity
+ *
+ * @param pitch
+ *		pitch PID entity
+ *
+ * @param yaw
+ *		yaw PID entity
+ *
+ * @return
+ *		void
+ *
+ */
+void pidBankInit(PID_BANK_STRUCT *bank, PID_STRUCT *roll, PID_STRUCT *pitch,
+		PID_STRUCT *yaw) {
+
+	PID_STRUCT *pid;
+	int i = 0;
+
+	memset(bank, 0, sizeof(PID_BANK_STRUCT));
+	bank->pid[PID_BANK_ROLL] = roll;
+	bank->pid[PID_BANK_PITCH] = pitch;
+	bank->pid[PID_BANK_YAW] = yaw;
+
+	for (i = 0; i < PID_BANK_SIZE; i++) {
+		pid = bank->pid[i];
+		bank->pv[i] = pid->pv;
+		bank->sp[i] = pid->sp;
+		bank->spShift[i] = pid->spShift;
+		bank->err[i] = pid->err;
+		bank->integral[i] = pid->integral;
+		bank->lastError[i] = pid->last_error;
+		bank->pgain[i] = pid->pgain;
+		bank->igain[i] = pid->igain;
+		bank->iLimit[i] = pid->iLimit;
+		bank->dgain[i] = pid->dgain;
+		bank->deadBand[i] = pid->deadBand;
+		bank->lastPv[i] = pid->lastPv;
+		bank->dFiltered[i] = pid->dFiltered;
+		bank->dCutoffFreq[i] = pid->dCutoffFreq;
+		bank->dRc[i] = getDerivativeFilterRc(pid->dCutoffFreq);
+		bank->ffGain[i] = pid->ffGain;
+		bank->output[i] = pid->output;
+		bank->dOnMeasurement[i] = pid->dOnMeasurement ? -1 : 0;
+		bank->isStarted[i] = pid->isStarted ? -1 : 0;
+		pid->bank = bank;
+		pid->lane = i;
+	}
+}
+
+/**
+ * PID conrroler of roll, pitch and yaw in one pass.
+ * The lanes are computed with the same steps as pidCalculation, directly on the settings
+ * and records held by the bank.
+ *
+ * @param bank
+ *		PID bank
+ *
+ * @param processValue
+ *		inputs of roll, pitch and yaw PID controlers
+ *
+ * @param dt
+ *		time since the previous sample (sec), a calculation with dt<=0 is skipped
+ *		and the previous outputs are held
+ *
+ * @param outputLimit
+ *		each output is limited in [-outputLimit, outputLimit]
+ *
+ * @param output
+ *		outputs of roll, pitch and yaw PID controlers
+ *
+ * @return
+ *		void
+ *
+ */
+void pidBankCalculation(PID_BANK_STRUCT *bank, PID_VECTOR processValue,
+		float dt, float outputLimit, float *output) {
+
+	PID_VECTOR zero = { 0.f, 0.f, 0.f, 0.f };
+	PID_VECTOR_MASK started = { -1, -1, -1, -1 };
+	PID_VECTOR timeDiff = { dt, dt, dt, dt };
+	PID_VECTOR limit = { outputLimit, outputLimit, outputLimit, outputLimit };
+	PID_VECTOR sp;
+	PID_VECTOR err;
+	PID_VECTOR integral;
+	PID_VECTOR dAlpha;
+	PID_VECTOR dFiltered;
+	PID_VECTOR result;
+	int i = 0;
+
+	if (dt <= 0.f) {
+		for (i = 0; i < PID_BANK_SIZE; i++) {
+			output[i] = bank->output[i];
+		}
+		return;
+	}
+
+	// P term
+	sp = bank->sp + bank->spShift;
+	err = pidVectorDeadband(sp - processValue, bank->deadBand);
+
+	// I term
+	integral = pidVectorLimit(bank->integral + err * timeDiff, bank->iLimit);
+
+	// D term
+	dFiltered = pidVectorSelect(bank->dOnMeasurement,
+			bank->lastPv - processValue, err - bank->lastError) / timeDiff;
+	dAlpha = timeDiff / (timeDiff + bank->dRc);
+	dFiltered = bank->dFiltered + dAlpha * (dFiltered - bank->dFiltered);
+
+	// P, I, D and feed-forward terms
+	result = bank->pgain * err + bank->igain * integral
+			+ bank->dgain * dFiltered + bank->ffGain * sp;
+	result = pidVectorLimit(result, limit);
+
+	// the first calculation after reset only marks the controler as started
+	bank->pv = pidVectorSelect(bank->isStarted, processValue, bank->pv);
+	bank->err = pidVectorSelect(bank->isStarted, err, bank->err);
+	bank->integral = pidVectorSelect(bank->isStarted, integral, bank->integral);
+	bank->lastError = pidVectorSelect(bank->isStarted, err, bank->lastError);
+	bank->dFiltered = pidVectorSelect(bank->isStarted, dFiltered,
+			bank->dFiltered);
+	bank->output = pidVectorSelect(bank->isStarted, result, zero);
+	bank->lastPv = processValue;
+	bank->isStarted = started;
+
+	for (i = 0; i < PID_BANK_SIZE; i++) {
+		output[i] = bank->output[i];
+	}
+}
+
 /**
  * tune PID conrroler
  *
@@ -322,13 +581,13 @@ float pidCalculation(PID_STRUCT *pid, float processValue, bool outputP,
 void pidTune(PID_STRUCT *pid, float p_gain, float i_gain, float d_gain,
 		float set_point, float shift, float iLimit, float deadBand) {
 
-	pid->pgain = p_gain;
-	pid->igain = i_gain;
-	pid->iLimit = iLimit;
-	pid->dgain = d_gain;
-	pid->sp = set_point;
-	pid->spShift = shift;
-	pid->deadBand = deadBand;
+	PID_LANE(pid, pgain) = p_gain;
+	PID_LANE(pid, igain) = i_gain;
+	PID_LANE(pid, iLimit) = iLimit;
+	PID_LANE(pid, dgain) = d_gain;
+	PID_LANE(pid, sp) = set_point;
+	PID_LANE(pid, spShift) = shift;
+	PID_LANE(pid, deadBand) = deadBand;
 }
 
 /**
@@ -342,46 +601,151 @@ void pidTune(PID_STRUCT *pid, float p_gain, float i_gain, float d_gain,
  *
  */
 void resetPidRecord(PID_STRUCT *pid) {
+
+	PID_BANK_STRUCT *bank = pid->bank;
+
+	if (bank) {
+		bank->integral[pid->lane] = 0.f;
+		bank->err[pid->lane] = 0.f;
+		bank->lastError[pid->lane] = 0.f;
+		bank->lastPv[pid->lane] = 0.f;
+		bank->dFiltered[pid->lane] = 0.f;
+		bank->output[pid->lane] = 0.f;
+		bank->isStarted[pid->lane] = 0;
+		return;
+	}
+
 	pid->integral = 0.f;
 	pid->err = 0.f;
 	pid->last_error = 0.f;
-	pid->last_tv.tv_usec = 0;
-	pid->last_tv.tv_sec = 0;
+	pid->lastPv = 0.f;
+	pid->dFiltered = 0.f;
+	pid->output = 0.f;
+	pid->isStarted = false;
 }
 
 /**
- *  update PID tv
+ *  set dead band of PID controler
+ *
+ * @param pi
+ * 		PID entity
+ *
+ * @param value
+ * 		dead band of PID controler
+ *
+ * @return
+ *		 void
+ *
+ */
+void setPidDeadBand(PID_STRUCT *pi, float value) {
+	PID_LANE(pi, deadBand) = value;
+}
+
+/**
+ *  select the input of D term
  *
  * @param pid
- * 		PID record
+ * 		PID entity
+ *
+ * @param enable
+ * 		true: derivative of measurement, false: derivative of error
+ *
+ * @return
+ *		 void
+ *
+ */
+void setPidDOnMeasurement(PID_STRUCT *pid, bool enable) {
+
+	if (pid->bank) {
+		pid->bank->dOnMeasurement[pid->lane] = enable ? -1 : 0;
+	} else {
+		pid->dOnMeasurement = enable;
+	}
+}
+
+/**
+ *  get the input of D term
+ *
+ * @param pid
+ * 		PID entity
+ *
+ * @return
+ *		 true: derivative of measurement, false: derivative of error
+ *
+ */
+bool getPidDOnMeasurement(PID_STRUCT *pid) {
+
+	if (pid->bank) {
+		return pid->bank->dOnMeasurement[pid->lane] ? true : false;
+	}
+
+	return pid->dOnMeasurement;
+}
+
+/**
+ *  set cutoff frequency of the low-pass on D term
+ *
+ * @param pid
+ * 		PID entity
+ *
+ * @param freq
+ * 		cutoff frequency (Hz), 0 disables the filter
  *
  * @return
  *		 void
  *
  */
-void updatePidTv(PID_STRUCT *pid) {
+void setPidDCutoffFreq(PID_STRUCT *pid, float freq) {
 
-	struct timeval tv;
-	gettimeofday(&tv, NULL);
+	PID_LANE(pid, dCutoffFreq) = freq;
+	if (pid->bank) {
+		pid->bank->dRc[pid->lane] = getDerivativeFilterRc(freq);
+	}
+}
 
-	UPDATE_LAST_TIME(tv, pid->last_tv);
+/**
+ *  get cutoff frequency of the low-pass on D term
+ *
+ * @param pid
+ * 		PID entity
+ *
+ * @return
+ *		 cutoff frequency (Hz)
+ *
+ */
+float getPidDCutoffFreq(PID_STRUCT *pid) {
+	return PID_LANE(pid, dCutoffFreq);
 }
 
 /**
- *  set dead band of PID controler
+ *  set feed-forward gain of set point
  *
- * @param pi
+ * @param pid
  * 		PID entity
  *
- * @param value
- * 		dead band of PID controler
+ * @param gain
+ * 		feed-forward gain
  *
  * @return
  *		 void
  *
  */
-void setPidDeadBand(PID_STRUCT *pi, float value) {
-	pi->deadBand = value;
+void setPidFfGain(PID_STRUCT *pid, float gain) {
+	PID_LANE(pid, ffGain) = gain;
+}
+
+/**
+ *  get feed-forward gain of set point
+ *
+ * @param pid
+ * 		PID entity
+ *
+ * @return
+ *		 feed-forward gain
+ *
+ */
+float getPidFfGain(PID_STRUCT *pid) {
+	return PID_LANE(pid, ffGain);
 }
 
 /**
@@ -395,7 +759,7 @@ void setPidDeadBand(PID_STRUCT *pi, float value) {
  *
  */
 float getPidDeadBand(PID_STRUCT *pi) {
-	return pi->deadBand;
+	return PID_LANE(pi, deadBand);
 }
 
 /**
@@ -412,7 +776,7 @@ float getPidDeadBand(PID_STRUCT *pi) {
  *
  */
 void setPidError(PID_STRUCT *pi, float value) {
-	pi->err = value;
+	PID_LANE(pi, err) = value;
 }
 
 /**
@@ -426,7 +790,7 @@ void setPidError(PID_STRUCT *pi, float value) {
  *
  */
 float getPidSperror(PID_STRUCT *pi) {
-	return pi->err;
+	return PID_LANE(pi, err);
 }
 
 /**
@@ -443,7 +807,7 @@ float getPidSperror(PID_STRUCT *pi) {
  *
  */
 void setPidSpShift(PID_STRUCT *pi, float value) {
-	pi->spShift = value;
+	PID_LANE(pi, spShift) = value;
 }
 
 /**
@@ -457,7 +821,7 @@ void setPidSpShift(PID_STRUCT *pi, float value) {
  *
  */
 float getPidSpShift(PID_STRUCT *pi) {
-	return pi->spShift;
+	return PID_LANE(pi, spShift);
 }
 
 /**
@@ -474,7 +838,7 @@ float getPidSpShift(PID_STRUCT *pi) {
  *
  */
 void setPidSp(PID_STRUCT *pid, float set_point) {
-	pid->sp = set_point;
+	PID_LANE(pid, sp) = set_point;
 }
 
 /**
@@ -488,7 +852,7 @@ void setPidSp(PID_STRUCT *pid, float set_point) {
  *
  */
 float getPidSp(PID_STRUCT *pid) {
-	return pid->sp;
+	return PID_LANE(pid, sp);
 }
 
 /**
@@ -536,7 +900,7 @@ char *getName(PID_STRUCT *pid) {
  *
  */
 void setPGain(PID_STRUCT *pid, float gain) {
-	pid->pgain = gain;
+	PID_LANE(pid, pgain) = gain;
 }
 
 /**
@@ -550,7 +914,7 @@ void setPGain(PID_STRUCT *pid, float gain) {
  *
  */
 float getPGain(PID_STRUCT *pid) {
-	return pid->pgain;
+	return PID_LANE(pid, pgain);
 }
 
 /**
@@ -567,7 +931,7 @@ float getPGain(PID_STRUCT *pid) {
  *
  */
 void setIGain(PID_STRUCT *pid, float gain) {
-	pid->igain = gain;
+	PID_LANE(pid, igain) = gain;
 }
 
 /**
@@ -581,7 +945,7 @@ void setIGain(PID_STRUCT *pid, float gain) {
  *
  */
 float getIGain(PID_STRUCT *pid) {
-	return pid->igain;
+	return PID_LANE(pid, igain);
 }
 
 /**
@@ -598,7 +962,7 @@ float getIGain(PID_STRUCT *pid) {
  *
  */
 void setILimit(PID_STRUCT *pid, float v) {
-	pid->iLimit = v;
+	PID_LANE(pid, iLimit) = v;
 }
 
 /**
@@ -612,7 +976,7 @@ void setILimit(PID_STRUCT *pid, float v) {
  *
  */
 float getILimit(PID_STRUCT *pid) {
-	return pid->iLimit;
+	return PID_LANE(pid, iLimit);
 }
 
 /**
@@ -629,7 +993,7 @@ float getILimit(PID_STRUCT *pid) {
  *
  */
 void setDGain(PID_STRUCT *pid, float gain) {
-	pid->dgain = gain;
+	PID_LANE(pid, dgain) = gain;
 }
 
 /**
@@ -643,6 +1007,6 @@ void setDGain(PID_STRUCT *pid, float gain) {
  *
  */
 float getDGain(PID_STRUCT *pid) {
-	return pid->dgain;
+	return PID_LANE(pid, dgain);
 }
 
@@ -22,6 +22,8 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 ******************************************************************************/
 
+typedef struct pidBank PID_BANK_STRUCT;
+
 typedef struct {
 	char name[10]; //name of pid entity
 	float pv; //process value
@@ -34,10 +36,55 @@ typedef struct {
 	float dgain; //Kd
 	float err; //current error
 	float deadBand;
-	struct timeval last_tv;
+	bool isStarted; // false until the first calculation after reset
+	float output; // latest output, it is held when a cycle has no new sample
 	float last_error; //last error  of pid calculation
+	bool dOnMeasurement; // D term follows -pv instead of error, a step of sp doesn't kick the output
+	float dCutoffFreq; // cutoff frequency (Hz) of the first-order low-pass on D term, 0 disables it
+	float ffGain; // feed-forward gain of set point
+	float lastPv; // pv of last pid calculation
+	float dFiltered; // filtered derivative
+	PID_BANK_STRUCT *bank; // bank which holds settings and records of this entity, NULL if the entity holds them
+	int lane; // lane of this entity in bank
 } PID_STRUCT;
 
+typedef float PID_VECTOR __attribute__((vector_size(16))); // roll, pitch, yaw and a padding lane
+typedef int PID_VECTOR_MASK __attribute__((vector_size(16)));
+
+typedef enum {
+	PID_BANK_ROLL = 0,
+	PID_BANK_PITCH,
+	PID_BANK_YAW,
+	PID_BANK_SIZE
+} PID_BANK_AXIS;
+
+/**
+ * roll, pitch and yaw PID controlers of one stage of the cascade, laid out as structure of arrays,
+ * the lanes hold the settings and records, and the accessors of a bound PID_STRUCT read and write its lane
+ */
+struct pidBank {
+	PID_STRUCT *pid[PID_BANK_SIZE];
+	PID_VECTOR pv;
+	PID_VECTOR sp;
+	PID_VECTOR spShift;
+	PID_VECTOR err;
+	PID_VECTOR integral;
+	PID_VECTOR lastError;
+	PID_VECTOR pgain;
+	PID_VECTOR igain;
+	PID_VECTOR iLimit;
+	PID_VECTOR dgain;
+	PID_VECTOR deadBand;
+	PID_VECTOR lastPv;
+	PID_VECTOR dFiltered;
+	PID_VECTOR dCutoffFreq;
+	PID_VECTOR dRc; // time constant of the low-pass on D term, it follows dCutoffFreq
+	PID_VECTOR ffGain;
+	PID_VECTOR output;
+	PID_VECTOR_MASK dOnMeasurement;
+	PID_VECTOR_MASK isStarted;
+};
+
 extern PID_STRUCT rollAttitudePidSettings;
 extern PID_STRUCT pitchAttitudePidSettings;
 extern PID_STRUCT yawAttitudePidSettings;
@@ -49,10 +96,14 @@ extern PID_STRUCT altHoldAltSettings;
 extern PID_STRUCT altHoldlSpeedSettings;
 
 void pidInit(void);
-float pidCalculation(PID_STRUCT *pid, float processValue,bool outputP,bool outputI,bool outputD);
+float pidCalculation(PID_STRUCT *pid, float processValue, float dt, bool outputP,bool outputI,bool outputD);
 void pidTune(PID_STRUCT *pid, float p_gain, float i_gain, float d_gain,
 		float set_point, float shift, float ilimit,float deadBand);
 void resetPidRecord(PID_STRUCT *pid);
+void pidBankInit(PID_BANK_STRUCT *bank, PID_STRUCT *roll, PID_STRUCT *pitch,
+		PID_STRUCT *yaw);
+void pidBankCalculation(PID_BANK_STRUCT *bank, PID_VECTOR processValue,
+		float dt, float outputLimit, float *output);
 void setPidError(PID_STRUCT *pi, float value);
 float getPidSperror(PID_STRUCT *pi);
 void setPidSp(PID_STRUCT *pid, float set_point);
@@ -71,5 +122,10 @@ void setDGain(PID_STRUCT *pid, float gain);
 float getDGain(PID_STRUCT *pid);
 void setPidDeadBand(PID_STRUCT *pi, float value);
 float getPidDeadBand(PID_STRUCT *pi);
-void updatePidTv(PID_STRUCT *pid);
+void setPidDOnMeasurement(PID_STRUCT *pid, bool enable);
+bool getPidDOnMeasurement(PID_STRUCT *pid);
+void setPidDCutoffFreq(PID_STRUCT *pid, float freq);
+float getPidDCutoffFreq(PID_STRUCT *pid);
+void setPidFfGain(PID_STRUCT *pid, float gain);
+float getPidFfGain(PID_STRUCT *pid);
 
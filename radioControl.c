@@ -29,6 +29,7 @@
 #include <pthread.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <time.h>
 #include <wiringSerial.h>
 #include "cJSON.h"
 #include "commonLib.h"
@@ -36,6 +37,9 @@
 #include "pid.h"
 #include "motorControl.h"
 #include "systemControl.h"
+#include "periodicTask.h"
+#include "vehicleState.h"
+#include "controlCommand.h"
 #include "attitudeUpdate.h"
 #include "radioControl.h"
 #include "altHold.h"
@@ -66,8 +70,16 @@ void radioSetupFactor(char packet[PACKET_FIELD_NUM][PACKET_FIELD_LENGTH]);
 void radioSetupPid(char packet[PACKET_FIELD_NUM][PACKET_FIELD_LENGTH]);
 void radioSetupMagnetCalModeStatus(char packet[PACKET_FIELD_NUM][PACKET_FIELD_LENGTH]);
 bool radioSaveMagnetCalModeResult(char packet[PACKET_FIELD_NUM][PACKET_FIELD_LENGTH]);
+void radioStartAltHoldSensorCalibration(char packet[PACKET_FIELD_NUM][PACKET_FIELD_LENGTH]);
+void radioSetupPidExtension(char packet[PACKET_FIELD_NUM][PACKET_FIELD_LENGTH]);
+void radioSetupAltHoldSensorTimingBudget(char packet[PACKET_FIELD_NUM][PACKET_FIELD_LENGTH]);
+static void applyEnableFlySystem(CONTROL_COMMAND_STRUCT *command);
+static void applyControlMotion(CONTROL_COMMAND_STRUCT *command);
+static void applyHaltPi(CONTROL_COMMAND_STRUCT *command);
+static void applySetupPidExtension(CONTROL_COMMAND_STRUCT *command);
 
 #define CHECK_RECEIVER_PERIOD 0
+#define HALT_WAIT_CYCLES 100
 
 /**
  * init paramtes and states for radio
@@ -173,23 +185,25 @@ void printPayload(unsigned char *payload, unsigned int len) {
 void *radioTransmitThread(void *arg) {
 
 	char message[150];
-	short magCalRawData[9];
 	int fd = *(int *) arg;
+	PERIODIC_TASK_STRUCT transmitTask;
+	VEHICLE_STATE_STRUCT state;
+
+	setupNonRealTimeThread();
+	// packet counter of security mechanism counts transmit cycles, so missed cycles are caught up
+	periodicTaskInit(&transmitTask, "radio transmit", TRANSMIT_TIMER,
+			PERIODIC_TASK_CATCH_UP);
 
 	while (!getLeaveFlyControlerFlag()) {
+
+		getVehicleState(&state);
 		 
 		if(magnetCalibrationIsEnable()){
-
-			pthread_mutex_lock(&controlMotorMutex);
-			
-			getMagnetCalibrationRawData(magCalRawData);
-
-			pthread_mutex_unlock(&controlMotorMutex);
 			
 			snprintf(message, sizeof(message), "@2:%d:%d:%d:%d:%d:%d:%d:%d:%d#", 
-				magCalRawData[0],magCalRawData[1],magCalRawData[2],
-				magCalRawData[3],magCalRawData[4],magCalRawData[5],
-				magCalRawData[6],magCalRawData[7],magCalRawData[8]);
+				state.magCalRawData[0],state.magCalRawData[1],state.magCalRawData[2],
+				state.magCalRawData[3],state.magCalRawData[4],state.magCalRawData[5],
+				state.magCalRawData[6],state.magCalRawData[7],state.magCalRawData[8]);
 			
 		}else{
 		
@@ -197,23 +211,22 @@ void *radioTransmitThread(void *arg) {
 				
 				snprintf(message, sizeof(message),
 					"@1:%d:%d:%d:%d:%d:%d:%d:%d:%d:%d:%d:%d:%d:%d:%d:%d#",
-					(int) getRoll(), (int) getPitch(), (int) getYaw(),
-					(int) getCurrentAltHoldAltitude(),
-					(int) getPidSp(&rollAttitudePidSettings),
-					(int) getPidSp(&pitchAttitudePidSettings),
-					(int) (getYawCenterPoint()
-							+ getPidSp(&yawAttitudePidSettings)),
-					(int) getPidSp(&altHoldAltSettings), (int) getRollGyro(),
-					(int) getPitchGyro(), (int) getYawGyro(),
-					getThrottlePowerLevel(), getMotorPowerLevelCCW1(),
-					getMotorPowerLevelCW1(), getMotorPowerLevelCCW2(),
-					getMotorPowerLevelCW2());
+					(int) state.roll, (int) state.pitch, (int) state.yaw,
+					(int) state.altitude,
+					(int) state.rollSp,
+					(int) state.pitchSp,
+					(int) state.yawSp,
+					(int) state.altitudeSp, (int) state.rollGyro,
+					(int) state.pitchGyro, (int) state.yawGyro,
+					state.throttle, state.motorCCW1,
+					state.motorCW1, state.motorCCW2,
+					state.motorCW2);
 				
 			}else{
 	
-				snprintf(message, sizeof(message), "@1:%d:%d:%d:%d#", (int) getRoll(),
-						(int) getPitch(), (int) getYaw(),
-						(int) getCurrentAltHoldAltitude());
+				snprintf(message, sizeof(message), "@1:%d:%d:%d:%d#", (int) state.roll,
+						(int) state.pitch, (int) state.yaw,
+						(int) state.altitude);
 			}
 		}	
 	
@@ -225,7 +238,7 @@ void *radioTransmitThread(void *arg) {
 			memset(message, '\0', sizeof(message));
 		}
 
-		usleep(TRANSMIT_TIMER);
+		periodicTaskWait(&transmitTask);
 	}
 
 	pthread_exit((void *) 0);
@@ -251,10 +264,15 @@ void *radioReceiveThread(void *arg) {
 	char getChar;
 	unsigned char count = 0;
 	short i = 0;
+	PERIODIC_TASK_STRUCT receiveTask;
 	
 	memset(buf, '\0', sizeof(buf));
 	memset(serialBuf, '\0', sizeof(serialBuf));
 
+	setupNonRealTimeThread();
+	periodicTaskInit(&receiveTask, "radio receive", RECEIVE_TIMER,
+			PERIODIC_TASK_SKIP);
+
 	while (!getLeaveFlyControlerFlag()) {
 
 		if (serialDataAvail(fd)) {
@@ -296,10 +314,13 @@ void *radioReceiveThread(void *arg) {
 				}
 
 			}
-		} else {
-			usleep(RECEIVE_TIMER);
+
+			// read again at once, commands and back-to-back packets are not delayed
+			continue;
 		}
-		ignore: ;
+		
+		ignore:
+		periodicTaskWait(&receiveTask);
 	}
 
 	pthread_exit((void *) 0);
@@ -428,6 +449,15 @@ bool checkPacketFieldIsValid(char *buf, short lenth) {
 		case MAGNET_CALIBRATION_RESULT:
 			count2 = MAGNET_CALIBRATION_RESULT_END - 1;	
 			break;
+		case HEADER_ALTHOLD_SENSOR_CALIBRATION:
+			count2 = ALTHOLD_SENSOR_CALIBRATION_END - 1;
+			break;
+		case HEADER_SETUP_PID_EXTENSION:
+			count2 = SETUP_PID_EXTENSION_END - 1;
+			break;
+		case HEADER_ALTHOLD_SENSOR_TIMING_BUDGET:
+			count2 = ALTHOLD_SENSOR_TIMING_BUDGET_END - 1;
+			break;
 		default:
 			count2 = -1;
 			
@@ -541,6 +571,15 @@ unsigned short getChecksumFieldIndex(unsigned int header) {
 		case MAGNET_CALIBRATION_RESULT:
 			ret = MAGNET_CALIBRATION_RESULT_CHECKSUM;
 			break;
+		case HEADER_ALTHOLD_SENSOR_CALIBRATION:
+			ret = ALTHOLD_SENSOR_CALIBRATION_CHECKSUM;
+			break;
+		case HEADER_SETUP_PID_EXTENSION:
+			ret = SETUP_PID_EXTENSION_CHECKSUM;
+			break;
+		case HEADER_ALTHOLD_SENSOR_TIMING_BUDGET:
+			ret = ALTHOLD_SENSOR_TIMING_BUDGET_CHECKSUM;
+			break;
 		default:
 		_DEBUG(DEBUG_NORMAL, "%s can't find index, header=%d\n", __func__,
 				header);
@@ -633,6 +672,27 @@ bool processRadioMessages(int fd, char *buf, short lenth) {
 			}
 				
 			break;
+
+		case HEADER_ALTHOLD_SENSOR_CALIBRATION:
+
+			//run calibration of althold sensor again
+			radioStartAltHoldSensorCalibration(packet);
+
+			break;
+
+		case HEADER_SETUP_PID_EXTENSION:
+
+			//setup D term and feed-forward of a pid controler
+			radioSetupPidExtension(packet);
+
+			break;
+
+		case HEADER_ALTHOLD_SENSOR_TIMING_BUDGET:
+
+			//setup timing budget of althold sensor
+			radioSetupAltHoldSensorTimingBudget(packet);
+
+			break;
 			
 		default:
 
@@ -689,14 +749,14 @@ bool processRadioMessages(int fd, char *buf, short lenth) {
   * 		void
   */
  void radioEnableFlySystem(char packet[PACKET_FIELD_NUM][PACKET_FIELD_LENGTH]){
- 	
- 		if (1 == atoi(packet[ENABLE_FLY_SYSTEM_FIWLD_ISENABLE])) {
-			_DEBUG(DEBUG_NORMAL, "Enable Flysystem\n");
-			enableFlySystem();
-			motorInit();
-		} else {
-			_DEBUG(DEBUG_NORMAL, "Disable Flysystem\n");
-			disenableFlySystem();
+
+		CONTROL_COMMAND_STRUCT command;
+
+		command.type = CONTROL_COMMAND_ENABLE_FLY_SYSTEM;
+		command.isEnable = (1 == atoi(packet[ENABLE_FLY_SYSTEM_FIWLD_ISENABLE]));
+
+		if (!pushControlCommand(&command)) {
+			_DEBUG(DEBUG_NORMAL, "control command queue is full\n");
 		}
 		
 		getPacketDropRate();
@@ -713,20 +773,18 @@ bool processRadioMessages(int fd, char *buf, short lenth) {
   */
  void radioControlMotion(char packet[PACKET_FIELD_NUM][PACKET_FIELD_LENGTH]){
 
+	CONTROL_COMMAND_STRUCT command;
 	short parameter = 0;
-	float rollSpShift = 0;
-	float pitchSpShift = 0;
-	float yawShiftValue = 0;
-	float throttlePercentage = 0.f;
 
-	 rollSpShift = atof(packet[CONTROL_MOTION_ROLL_SP_SHIFT]);
-	 pitchSpShift = atof(packet[CONTROL_MOTION_PITCH_SP_SHIFT]);
-	 yawShiftValue = atof(packet[CONTROL_MOTION_YAW_SHIFT_VALUE]);
-	 throttlePercentage = atof(packet[CONTROL_MOTION_THROTTLE]);
+	 command.type = CONTROL_COMMAND_CONTROL_MOTION;
+	 command.rollSpShift = atof(packet[CONTROL_MOTION_ROLL_SP_SHIFT]);
+	 command.pitchSpShift = atof(packet[CONTROL_MOTION_PITCH_SP_SHIFT]);
+	 command.yawShiftValue = atof(packet[CONTROL_MOTION_YAW_SHIFT_VALUE]);
+	 command.throttlePercentage = atof(packet[CONTROL_MOTION_THROTTLE]);
 
-	 throttlePercentage = throttlePercentage * 0.01f;
+	 command.throttlePercentage = command.throttlePercentage * 0.01f;
 	 parameter = getMinPowerLevel()
-			 + (int) (throttlePercentage
+			 + (int) (command.throttlePercentage
 					 * (float) (getMaxPowerLeve() - getMinPowerLevel()));
 
 	 if (parameter > getMaxPowerLeve() || parameter < getMinPowerLevel()) {
@@ -734,17 +792,124 @@ bool processRadioMessages(int fd, char *buf, short lenth) {
 		 return;
 	 }
 
+	 command.throttle = (unsigned short) parameter;
+
 	 if (true == flySystemIsEnable()) {
 
-		 pthread_mutex_lock(&controlMotorMutex);
+		 if (!pushControlCommand(&command)) {
+			 _DEBUG(DEBUG_NORMAL, "control command queue is full\n");
+		 }
+	 }
 
-		 setThrottlePowerLevel(parameter);
+ }
+
+ /**
+  * Halt Pi
+  *
+  * @param packet
+  * 	 received packet
+  *
+  * @return
+  * 		void
+  */
+ void radioHaltPi(char packet[PACKET_FIELD_NUM][PACKET_FIELD_LENGTH]){
+
+	CONTROL_COMMAND_STRUCT command;
+	bool isPushed = false;
+	int i = 0;
+
+	command.type = CONTROL_COMMAND_HALT;
+
+	// the control thread stops the motors and main halts Pi after it leaves
+	for (i = 0; i < HALT_WAIT_CYCLES && !isPushed; i++) {
+		isPushed = pushControlCommand(&command);
+		if (!isPushed) {
+			usleep(RECEIVE_TIMER);
+		}
+	}
+
+	if (!isPushed) {
+		_DEBUG(DEBUG_NORMAL, "control command queue is full, halt is dropped\n");
+	}
+ }
+
+ /**
+  * apply the commands from radio, only the control thread calls this function
+  *
+  * @param
+  * 	 void
+  *
+  * @return
+  * 		void
+  */
+ void applyControlCommands(){
+
+	CONTROL_COMMAND_STRUCT command;
+
+	while (popControlCommand(&command)) {
+
+		switch (command.type) {
+
+			case CONTROL_COMMAND_ENABLE_FLY_SYSTEM:
+				applyEnableFlySystem(&command);
+				break;
+
+			case CONTROL_COMMAND_CONTROL_MOTION:
+				applyControlMotion(&command);
+				break;
+
+			case CONTROL_COMMAND_HALT:
+				applyHaltPi(&command);
+				break;
+
+			case CONTROL_COMMAND_SETUP_PID_EXTENSION:
+				applySetupPidExtension(&command);
+				break;
+		}
+	}
+ }
+
+ /**
+  * enable or disable fly system
+  *
+  * @param command
+  * 	 command
+  *
+  * @return
+  * 		void
+  */
+ static void applyEnableFlySystem(CONTROL_COMMAND_STRUCT *command){
+ 	
+ 		if (command->isEnable) {
+			_DEBUG(DEBUG_NORMAL, "Enable Flysystem\n");
+			enableFlySystem();
+			motorInit();
+		} else {
+			_DEBUG(DEBUG_NORMAL, "Disable Flysystem\n");
+			disenableFlySystem();
+		}
+ }
+
+ /**
+  * apply throttle and set points
+  *
+  * @param command
+  * 	 command
+  *
+  * @return
+  * 		void
+  */
+ static void applyControlMotion(CONTROL_COMMAND_STRUCT *command){
+
+	 if (true == flySystemIsEnable()) {
+
+		 setThrottlePowerLevel(command->throttle);
 
 		 if(getEnableAltHold() && getAltHoldIsReady()){
-			 updateTargetAltitude(throttlePercentage);
+			 updateTargetAltitude(command->throttlePercentage);
 		 }
 
-		 if (getMinPowerLevel() == parameter) {
+		 if (getMinPowerLevel() == command->throttle) {
 
 			 resetPidRecord(&rollAttitudePidSettings);
 			 resetPidRecord(&pitchAttitudePidSettings);
@@ -767,38 +932,62 @@ bool processRadioMessages(int fd, char *buf, short lenth) {
 			 }
 
 			 setPidSp(&rollAttitudePidSettings,
-					 LIMIT_MIN_MAX_VALUE(rollSpShift, -getAngularLimit(),
+					 LIMIT_MIN_MAX_VALUE(command->rollSpShift, -getAngularLimit(),
 							 getAngularLimit()));
 			 setPidSp(&pitchAttitudePidSettings,
-					 LIMIT_MIN_MAX_VALUE(pitchSpShift, -getAngularLimit(),
+					 LIMIT_MIN_MAX_VALUE(command->pitchSpShift, -getAngularLimit(),
 							 getAngularLimit()));
-			 setYawCenterPoint(getYawCenterPoint() + (yawShiftValue * 4));
+			 setYawCenterPoint(getYawCenterPoint() + (command->yawShiftValue * 4));
 
 			 //_DEBUG(DEBUG_NORMAL,"setYawCenterPoint=%f\n",getYawCenterPoint());
 		 }
-		 pthread_mutex_unlock(&controlMotorMutex);
-
 	 }
 
  }
 
  /**
-  * Halt Pi
+  * stop motors and leave fly controler before halting Pi
   *
-  * @param packet
-  * 	 received packet
+  * @param command
+  * 	 command
   *
   * @return
   * 		void
   */
- void radioHaltPi(char packet[PACKET_FIELD_NUM][PACKET_FIELD_LENGTH]){
-	pthread_mutex_lock(&controlMotorMutex);
+ static void applyHaltPi(CONTROL_COMMAND_STRUCT *command){
 	setThrottlePowerLevel(0);
 	setupAllMotorPoewrLevel(0, 0, 0, 0);
 	disenableFlySystem();
+	setHaltPiFlag(true);
 	setLeaveFlyControlerFlag(true);
-	pthread_mutex_unlock(&controlMotorMutex);
-	system("sudo halt");
+ }
+
+ /**
+  * setup D term and feed-forward of a pid controler
+  *
+  * @param command
+  * 	 command
+  *
+  * @return
+  * 		void
+  */
+ static void applySetupPidExtension(CONTROL_COMMAND_STRUCT *command){
+
+	PID_STRUCT *pids[SETUP_PID_EXTENSION_CONTROLER_END] = {
+		&rollAttitudePidSettings, &pitchAttitudePidSettings,
+		&yawAttitudePidSettings, &rollRatePidSettings, &pitchRatePidSettings,
+		&yawRatePidSettings, &altHoldAltSettings, &altHoldlSpeedSettings,
+		&verticalAccelPidSettings };
+	PID_STRUCT *pid = pids[command->pidIndex];
+
+	setPidDOnMeasurement(pid, command->dOnMeasurement);
+	setPidDCutoffFreq(pid, command->dCutoffFreq);
+	setPidFfGain(pid, command->ffGain);
+
+	_DEBUG(DEBUG_NORMAL,
+			"%s D on measurement=%d, D cutoff=%4.6f Hz, FF Gain=%4.6f\n",
+			getName(pid), getPidDOnMeasurement(pid), getPidDCutoffFreq(pid),
+			getPidFfGain(pid));
  }
 
  /**
@@ -1196,6 +1385,84 @@ void radioSetupMagnetCalModeStatus(char packet[PACKET_FIELD_NUM][PACKET_FIELD_LE
 	 
 }
 
+/**
+ * run calibration of althold sensor again, it is refused while fly system is enabled
+ *
+ * @param packet
+ *		received packet
+ *
+ * @return
+ *		   void
+ */
+void radioStartAltHoldSensorCalibration(char packet[PACKET_FIELD_NUM][PACKET_FIELD_LENGTH]){
+
+	if (flySystemIsEnable()) {
+		_DEBUG(DEBUG_NORMAL, "Can't calibrate althold sensor while fly system is enabled\n");
+		return;
+	}
+
+	if (requestAltHoldSensorCalibration()) {
+		_DEBUG(DEBUG_NORMAL, "Start althold sensor calibration\n");
+	} else {
+		_DEBUG(DEBUG_NORMAL, "Althold sensor doesn't support calibration\n");
+	}
+}
+
+/**
+ * setup timing budget of althold sensor, a longer budget is more accurate and a shorter one is faster
+ *
+ * @param packet
+ *		received packet
+ *
+ * @return
+ *		   void
+ */
+void radioSetupAltHoldSensorTimingBudget(char packet[PACKET_FIELD_NUM][PACKET_FIELD_LENGTH]){
+
+	unsigned long budget = strtoul(packet[ALTHOLD_SENSOR_TIMING_BUDGET_VALUE], NULL, 10);
+
+	if (setAltHoldSensorTimingBudget(budget)) {
+		_DEBUG(DEBUG_NORMAL, "Althold sensor timing budget=%ld us\n", budget);
+	} else {
+		_DEBUG(DEBUG_NORMAL, "Can't set althold sensor timing budget=%ld us\n", budget);
+	}
+}
+
+/**
+ * setup D term and feed-forward of a pid controler,
+ * one packet carries the settings of the controler indexed by SETUP_PID_EXTENSION_CONTROLER,
+ * they are applied by the control thread
+ *
+ * @param packet
+ *		received packet
+ *
+ * @return
+ *		   void
+ */
+void radioSetupPidExtension(char packet[PACKET_FIELD_NUM][PACKET_FIELD_LENGTH]){
+
+	CONTROL_COMMAND_STRUCT command;
+
+	command.type = CONTROL_COMMAND_SETUP_PID_EXTENSION;
+	command.pidIndex = atoi(packet[SETUP_PID_EXTENSION_CONTROLER]);
+	command.dOnMeasurement =
+			(0 != atoi(packet[SETUP_PID_EXTENSION_D_ON_MEASUREMENT]));
+	command.dCutoffFreq =
+			max(0.f, atof(packet[SETUP_PID_EXTENSION_D_CUTOFF_FREQ]));
+	command.ffGain = atof(packet[SETUP_PID_EXTENSION_FF_GAIN]);
+
+	if (command.pidIndex < 0
+			|| command.pidIndex >= SETUP_PID_EXTENSION_CONTROLER_END) {
+		_DEBUG(DEBUG_NORMAL, "Unknown pid controler index=%d\n",
+				command.pidIndex);
+		return;
+	}
+
+	if (!pushControlCommand(&command)) {
+		_DEBUG(DEBUG_NORMAL, "control command queue is full\n");
+	}
+}
+
 /**
  * save the result of Magnet calibration mode 
  *
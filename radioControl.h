@@ -38,6 +38,9 @@ typedef enum {
 	HEADER_SETUP_PID,
 	MAGNET_CALIBRATION_START,
 	MAGNET_CALIBRATION_RESULT,
+	HEADER_ALTHOLD_SENSOR_CALIBRATION,
+	HEADER_SETUP_PID_EXTENSION,
+	HEADER_ALTHOLD_SENSOR_TIMING_BUDGET,
 	HEADER_END
 } CONTROL_PACKET_HEADER;
 
@@ -161,7 +164,44 @@ typedef enum {
 	MAGNET_CALIBRATION_RESULT_END
 } MAGNET_CALIBRATION_RESULT_FIWLD;
 
+typedef enum {
+	ALTHOLD_SENSOR_CALIBRATION_HEADER,
+	ALTHOLD_SENSOR_CALIBRATION_CHECKSUM,
+	ALTHOLD_SENSOR_CALIBRATION_END
+} ALTHOLD_SENSOR_CALIBRATION_FIWLD;
+
+typedef enum {
+	SETUP_PID_EXTENSION_HEADER,
+	SETUP_PID_EXTENSION_CONTROLER,
+	SETUP_PID_EXTENSION_D_ON_MEASUREMENT,
+	SETUP_PID_EXTENSION_D_CUTOFF_FREQ,
+	SETUP_PID_EXTENSION_FF_GAIN,
+	SETUP_PID_EXTENSION_CHECKSUM,
+	SETUP_PID_EXTENSION_END
+} SETUP_PID_EXTENSION_FIWLD;
+
+typedef enum {
+	SETUP_PID_EXTENSION_ATTITUDE_ROLL,
+	SETUP_PID_EXTENSION_ATTITUDE_PITCH,
+	SETUP_PID_EXTENSION_ATTITUDE_YAW,
+	SETUP_PID_EXTENSION_RATE_ROLL,
+	SETUP_PID_EXTENSION_RATE_PITCH,
+	SETUP_PID_EXTENSION_RATE_YAW,
+	SETUP_PID_EXTENSION_VERTICAL_HEIGHT,
+	SETUP_PID_EXTENSION_VERTICAL_SPEED,
+	SETUP_PID_EXTENSION_VERTICAL_ACCEL,
+	SETUP_PID_EXTENSION_CONTROLER_END
+} SETUP_PID_EXTENSION_CONTROLER_INDEX;
+
+typedef enum {
+	ALTHOLD_SENSOR_TIMING_BUDGET_HEADER,
+	ALTHOLD_SENSOR_TIMING_BUDGET_VALUE,
+	ALTHOLD_SENSOR_TIMING_BUDGET_CHECKSUM,
+	ALTHOLD_SENSOR_TIMING_BUDGET_END
+} ALTHOLD_SENSOR_TIMING_BUDGET_FIWLD;
+
 bool radioControlInit();
 void closeRadio();
 void getPacketDropRate();
+void applyControlCommands();
 
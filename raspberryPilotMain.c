@@ -40,11 +40,23 @@ SOFTWARE.
 #include "securityMechanism.h"
 #include "ahrs.h"
 #include "attitudeUpdate.h"
+#include "sampleClock.h"
+#include "vehicleState.h"
 
-#define CONTROL_CYCLE_TIME 500
-#define CHECK_RASPBERRYPILOT_LOOP_TIME 0
+#define DEADLINE_MISS_REPORT_PERIOD 1000000 // us
+#define MAX_SAMPLE_TIMEOUTS 5 // consecutive timeouts of the sample clock before it is replaced by the polling clock
+#define MAX_IMU_SAMPLE_AGE (5 * getMpu6050SamplePeriod()) // us, motor outputs are held no longer than it
+#define IMU_SAMPLE_AGE_REPORT_PERIOD 1000000 // us
+
+static pthread_t controlThreadId;
+static unsigned long deadlineMissCount = 0;
 
 bool raspberryPilotInit();
+static void *controlThread(void *arg);
+static void controlCycle();
+static void sampleTimeoutCycle();
+static bool imuSampleIsStale();
+static void checkControlCycleDeadline(struct timeval start_tv);
 
 /**
  * RaspberryPilot man function
@@ -58,74 +70,235 @@ bool raspberryPilotInit();
  */
 int main() {
 
-	struct timeval tv_c;
-	struct timeval tv_l;
-	unsigned long timeDiff=0;
-
 	if (!raspberryPilotInit()) {
 		return false;
 	}
 
-	gettimeofday(&tv_l,NULL);
+	if (pthread_create(&controlThreadId, NULL, controlThread, 0)) {
+		_ERROR("(%s-%d) control thread create failed\n", __func__, __LINE__);
+		return false;
+	}
 
-	while (!getLeaveFlyControlerFlag()) {
+	pthread_join(controlThreadId, NULL);
 
-		gettimeofday(&tv_c,NULL);
-		timeDiff=GET_USEC_TIMEDIFF(tv_c,tv_l);
+	if (getHaltPiFlag()) {
+		system("sudo halt");
+	}
 
-		if(timeDiff >=((unsigned long) (getAdjustPeriod() * CONTROL_CYCLE_TIME))){
+	return 0;
+}
 
-#if CHECK_RASPBERRYPILOT_LOOP_TIME
-			_DEBUG(DEBUG_NORMAL,"RaspberryPilot main duration=%ld us\n",timeDiff);
+/**
+ * control thread, runs a control cycle per sample,
+ * it becomes a SCHED_FIFO thread pinned on its own CPU core in real-time mode
+ *
+ * @param arg
+ *		arg
+ *
+ * @return
+ *		pointer
+ *
+ */
+static void *controlThread(void *arg) {
+
+	struct timeval start_tv;
+	int timeoutCount = 0;
+
+#ifdef RT_CONTROL_THREAD
+	lockProcessMemory();
+	setCurrentThreadAffinity(RT_CONTROL_THREAD_CPU);
+	setCurrentThreadRealTime(RT_CONTROL_THREAD_PRIORITY);
+	_DEBUG(DEBUG_NORMAL, "control thread: SCHED_FIFO %d on CPU %d\n",
+			RT_CONTROL_THREAD_PRIORITY, RT_CONTROL_THREAD_CPU);
 #endif
-			pthread_mutex_lock(&controlMotorMutex);
 
-			if(!magnetCalibrationIsEnable()){
+	while (!getLeaveFlyControlerFlag()) {
+
+		if(waitForNextSample()){
+
+			timeoutCount = 0;
+			gettimeofday(&start_tv, NULL);
+			controlCycle();
+			checkControlCycleDeadline(start_tv);
+		}else{
+
+			sampleTimeoutCycle();
+
+			if (++timeoutCount >= MAX_SAMPLE_TIMEOUTS) {
+				setThrottlePowerLevel(0);
+				setupAllMotorPoewrLevel(0, 0, 0, 0);
+				disenableFlySystem();
+				if (!sampleClockFallBackToPolling()) {
+					_ERROR("(%s-%d) polling clock init failed\n", __func__,
+							__LINE__);
+				}
+				timeoutCount = 0;
+			}
+		}
+	}
+
+	pthread_exit((void *) 0);
+}
 
-				attitudeUpdate();
+/**
+ * a control cycle: update attitude and motors
+ *
+ * @param
+ *		void
+ *
+ * @return
+ *		void
+ *
+ */
+static void controlCycle() {
+
+	bool attitudeIsUpdated;
 
-				if (flySystemIsEnable()){
+	applyControlCommands();
 
-					disenableMagnetCalibration();
-					
-					if (getPacketCounter() < MAX_COUNTER) {
-						
-						if (getPidSp(&yawAttitudePidSettings) != 321.0) {
-								
-								motorControler();
-										
-						} else {
+	if(!magnetCalibrationIsEnable()){
 
-							setThrottlePowerLevel(getMinPowerLevel());
-							setupAllMotorPoewrLevel(getMinPowerLevel(),
-									getMinPowerLevel(), getMinPowerLevel(),
-									getMinPowerLevel());
-						}
-					} else {
+		attitudeIsUpdated = attitudeUpdate();
 
-						//security mechanism is triggered while connection is broken
-						triggerSecurityMechanism();
+		if (getAltHoldIsReady()) {
+			updateAltitudeEstimate();
+		}
+
+		if (flySystemIsEnable()){
+
+			disenableMagnetCalibration();
+			
+			if (getPacketCounter() < MAX_COUNTER) {
+				
+				if (getPidSp(&yawAttitudePidSettings) != 321.0) {
+
+					// without a new IMU sample the previous motor outputs are held for a while
+					if (attitudeIsUpdated) {
+						motorControler();
+					} else if (imuSampleIsStale()) {
+						setThrottlePowerLevel(getMinPowerLevel());
+						setupAllMotorPoewrLevel(getMinPowerLevel(),
+								getMinPowerLevel(), getMinPowerLevel(),
+								getMinPowerLevel());
 					}
 
 				} else {
 
-					setThrottlePowerLevel(0);
-					setupAllMotorPoewrLevel(0, 0, 0, 0);
+					setThrottlePowerLevel(getMinPowerLevel());
+					setupAllMotorPoewrLevel(getMinPowerLevel(),
+							getMinPowerLevel(), getMinPowerLevel(),
+							getMinPowerLevel());
 				}
-			}else{
+			} else {
 
-				magnetCalibrationGetImuRawData();
+				//security mechanism is triggered while connection is broken
+				triggerSecurityMechanism();
 			}
 
-			pthread_mutex_unlock(&controlMotorMutex);
-			
-			UPDATE_LAST_TIME(tv_c,tv_l);
+		} else {
 
+			setThrottlePowerLevel(0);
+			setupAllMotorPoewrLevel(0, 0, 0, 0);
 		}
+	}else{
 
-		usleep(500);
+		magnetCalibrationGetImuRawData();
+	}
+
+	publishVehicleState();
+}
+
+/**
+ * check whether the latest IMU sample is too old to hold the motor outputs, and report it
+ *
+ * @param
+ *		void
+ *
+ * @return
+ *		bool
+ *
+ */
+static bool imuSampleIsStale() {
+
+	static struct timeval report_tv;
+	struct timeval sample_tv;
+	struct timeval tv;
+	unsigned long age;
+
+	getAttitudeSampleTv(&sample_tv);
+	gettimeofday(&tv, NULL);
+	age = TIME_IS_UPDATED(sample_tv) ?
+			GET_USEC_TIMEDIFF(tv, sample_tv) : MAX_IMU_SAMPLE_AGE;
+
+	if (age < MAX_IMU_SAMPLE_AGE) {
+		return false;
+	}
+
+	if (GET_USEC_TIMEDIFF(tv, report_tv) >= IMU_SAMPLE_AGE_REPORT_PERIOD) {
+		_ERROR("(%s-%d) no IMU sample for %ld us, motors drop to min power\n",
+				__func__, __LINE__, age);
+		UPDATE_LAST_TIME(tv, report_tv);
+	}
+
+	return true;
+}
+
+/**
+ * a cycle without sample: radio commands are still applied, and the motors are stopped
+ * or lowered by the security mechanism, because the attitude is not updated
+ *
+ * @param
+ *		void
+ *
+ * @return
+ *		void
+ *
+ */
+static void sampleTimeoutCycle() {
+
+	applyControlCommands();
+
+	if (!flySystemIsEnable()) {
+
+		setThrottlePowerLevel(0);
+		setupAllMotorPoewrLevel(0, 0, 0, 0);
+	} else if (getPacketCounter() >= MAX_COUNTER) {
+
+		//security mechanism is triggered while connection is broken
+		triggerSecurityMechanism();
+	}
+}
+
+/**
+ * check whether a control cycle finished within the sample period, and report the misses
+ *
+ * @param start_tv
+ *		the time when the cycle started
+ *
+ * @return
+ *		void
+ *
+ */
+static void checkControlCycleDeadline(struct timeval start_tv) {
+
+	static struct timeval report_tv;
+	struct timeval tv;
+	unsigned long duration;
+
+	gettimeofday(&tv, NULL);
+	duration = GET_USEC_TIMEDIFF(tv, start_tv);
+
+	if (duration > getSamplePeriod()) {
+
+		deadlineMissCount++;
+
+		if (GET_USEC_TIMEDIFF(tv, report_tv) >= DEADLINE_MISS_REPORT_PERIOD) {
+			_DEBUG(DEBUG_NORMAL,
+					"control cycle missed deadline: %ld us > %ld us (%ld misses)\n",
+					duration, getSamplePeriod(), deadlineMissCount);
+			UPDATE_LAST_TIME(tv, report_tv);
+		}
 	}
-	return 0;
 }
 
 /**
@@ -178,6 +351,11 @@ bool raspberryPilotInit() {
 		return false;
 	}
 
+	if (!sampleClockInit()) {
+		_ERROR("(%s-%d) sample clock init failed\n", __func__, __LINE__);
+		return false;
+	}
+
 	_DEBUG(DEBUG_NORMAL, "(%s-%d) Raspberry Pilot init done\n", __func__,
 			__LINE__);
 	return true;
@@ -0,0 +1,399 @@
+/******************************************************************************
+The sampleClock.c in RaspberryPilot project is placed under the MIT license
+
+Copyright (c) 2016 jellyice1986 (Tung-Cheng Wu)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/time.h>
+#include <semaphore.h>
+#include <wiringPi.h>
+#include "commonLib.h"
+#include "flyControler.h"
+#include "mpu6050.h"
+#include "periodicTask.h"
+#include "sampleClock.h"
+
+#define CHECK_SAMPLE_CLOCK_JITTER 0
+#define SAMPLE_CLOCK_JITTER_REPORT_CYCLES 10000
+#define DATA_READY_TIMEOUT 100000 // us
+
+static bool pollingClockInit();
+static bool pollingClockWaitForSample();
+static unsigned long pollingClockGetPeriod();
+#ifdef MPU6050_DATA_READY_INTERRUPT
+static bool dataReadyClockInit();
+static bool dataReadyClockWaitForSample();
+static unsigned long dataReadyClockGetPeriod();
+static void dataReadyIsr(void);
+static sem_t dataReadySem;
+#endif
+static void updateJitterHistogram(SAMPLE_CLOCK_STRUCT *clock);
+static PERIODIC_TASK_STRUCT pollingTask;
+
+static SAMPLE_CLOCK_STRUCT pollingClock = { "POLLING", pollingClockInit,
+		pollingClockWaitForSample, pollingClockGetPeriod };
+#ifdef MPU6050_DATA_READY_INTERRUPT
+static SAMPLE_CLOCK_STRUCT dataReadyClock = { "DATA_RDY", dataReadyClockInit,
+		dataReadyClockWaitForSample, dataReadyClockGetPeriod };
+static SAMPLE_CLOCK_STRUCT *sampleClock = &dataReadyClock;
+#else
+static SAMPLE_CLOCK_STRUCT *sampleClock = &pollingClock;
+#endif
+
+/**
+ * init the sample clock which drives the control cycle
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		bool
+ *
+ */
+bool sampleClockInit() {
+
+	_DEBUG(DEBUG_NORMAL, "sample clock: %s\n", sampleClock->name);
+	resetSampleClockJitterHistogram();
+
+	return sampleClock->init();
+}
+
+/**
+ * replace the sample clock, a simulated sample source can drive the control cycle by this way
+ *
+ * @param clock
+ * 		sample clock
+ *
+ * @return
+ *		void
+ *
+ */
+void setSampleClock(SAMPLE_CLOCK_STRUCT *clock) {
+	sampleClock = clock;
+}
+
+/**
+ * get the sample clock which drives the control cycle
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		sample clock
+ *
+ */
+SAMPLE_CLOCK_STRUCT *getSampleClock() {
+	return sampleClock;
+}
+
+/**
+ * block until next sample and record the interval between two samples
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		true if a new sample arrived
+ *
+ */
+bool waitForNextSample() {
+
+	if (!sampleClock->waitForSample()) {
+		return false;
+	}
+
+	updateJitterHistogram(sampleClock);
+
+	return true;
+}
+
+/**
+ * replace the sample clock by the polling clock, it is used when the source of samples stops
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		bool
+ *
+ */
+bool sampleClockFallBackToPolling() {
+
+	if (sampleClock == &pollingClock) {
+		return true;
+	}
+
+	_ERROR("(%s-%d) sample clock %s stops, fall back to %s\n", __func__,
+			__LINE__, sampleClock->name, pollingClock.name);
+	sampleClock = &pollingClock;
+	resetSampleClockJitterHistogram();
+
+	return sampleClock->init();
+}
+
+/**
+ * get the nominal interval between two samples, it is the deadline of a control cycle
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		period (us)
+ *
+ */
+unsigned long getSamplePeriod() {
+	return sampleClock->getPeriod();
+}
+
+/**
+ * put the interval between this sample and the previous one into the histogram
+ *
+ * @param clock
+ * 		sample clock
+ *
+ * @return
+ *		void
+ *
+ */
+static void updateJitterHistogram(SAMPLE_CLOCK_STRUCT *clock) {
+
+	struct timeval tv;
+	unsigned long bucket;
+#if CHECK_SAMPLE_CLOCK_JITTER
+	static unsigned long cycles = 0;
+#endif
+
+	gettimeofday(&tv, NULL);
+
+	if (TIME_IS_UPDATED(clock->last_tv)) {
+		bucket = GET_USEC_TIMEDIFF(tv, clock->last_tv)
+				/ SAMPLE_CLOCK_JITTER_BUCKET_SIZE;
+		clock->intervalHistogram[min(bucket,
+				SAMPLE_CLOCK_JITTER_BUCKET_NUM - 1)]++;
+	}
+
+	UPDATE_LAST_TIME(tv, clock->last_tv);
+
+#if CHECK_SAMPLE_CLOCK_JITTER
+	if (++cycles >= SAMPLE_CLOCK_JITTER_REPORT_CYCLES) {
+		printSampleClockJitterHistogram();
+		resetSampleClockJitterHistogram();
+		cycles = 0;
+	}
+#endif
+}
+
+/**
+ * print the histogram of intervals between two samples
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		void
+ *
+ */
+void printSampleClockJitterHistogram() {
+
+	int i;
+
+	_DEBUG(DEBUG_NORMAL, "%s sample interval histogram (missed %ld):\n",
+			sampleClock->name, sampleClock->missedSamples);
+
+	for (i = 0; i < SAMPLE_CLOCK_JITTER_BUCKET_NUM; i++) {
+		if (sampleClock->intervalHistogram[i] > 0) {
+			_DEBUG(DEBUG_NORMAL, "%s%5d us: %ld\n",
+					(i == SAMPLE_CLOCK_JITTER_BUCKET_NUM - 1) ? ">=" : "  ",
+					i * SAMPLE_CLOCK_JITTER_BUCKET_SIZE,
+					sampleClock->intervalHistogram[i]);
+		}
+	}
+}
+
+/**
+ * reset the histogram of intervals between two samples
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		void
+ *
+ */
+void resetSampleClockJitterHistogram() {
+
+	memset(sampleClock->intervalHistogram, 0,
+			sizeof(sampleClock->intervalHistogram));
+	sampleClock->missedSamples = 0;
+	sampleClock->last_tv.tv_sec = 0;
+	sampleClock->last_tv.tv_usec = 0;
+}
+
+/**
+ * init polling clock
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		bool
+ *
+ */
+static bool pollingClockInit() {
+
+	periodicTaskInit(&pollingTask, "control cycle", pollingClockGetPeriod(),
+			PERIODIC_TASK_SKIP);
+
+	return true;
+}
+
+/**
+ * polling clock, sleep until the next release of a fixed-rate control cycle,
+ * the cycles which are missed by an overrun are dropped
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		bool
+ *
+ */
+static bool pollingClockWaitForSample() {
+
+	periodicTaskSetPeriod(&pollingTask, pollingClockGetPeriod());
+	pollingClock.missedSamples += periodicTaskWait(&pollingTask);
+
+	return true;
+}
+
+/**
+ * get period of polling clock
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		period (us)
+ *
+ */
+static unsigned long pollingClockGetPeriod() {
+	return (unsigned long) (getAdjustPeriod() * CONTROL_CYCLE_TIME);
+}
+
+#ifdef MPU6050_DATA_READY_INTERRUPT
+/**
+ * init data ready clock, MPU6050 raises INT pin when a sample is ready
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		bool
+ *
+ */
+static bool dataReadyClockInit() {
+
+	if (sem_init(&dataReadySem, 0, 0) != 0) {
+		_ERROR("(%s-%d) sem_init failed\n", __func__, __LINE__);
+		return false;
+	}
+
+	if (wiringPiISR(MPU6050_INT_PIN, INT_EDGE_RISING, &dataReadyIsr) < 0) {
+		_ERROR("(%s-%d) wiringPiISR failed\n", __func__, __LINE__);
+		return false;
+	}
+
+	mpu6050EnableDataReadyInterrupt();
+
+	return true;
+}
+
+/**
+ * ISR of MPU6050 INT pin
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		void
+ *
+ */
+static void dataReadyIsr(void) {
+	sem_post(&dataReadySem);
+}
+
+/**
+ * data ready clock, block on the edge of MPU6050 INT pin,
+ * the edges which are queued while the previous cycle overran are counted as missed samples
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		bool
+ *
+ */
+static bool dataReadyClockWaitForSample() {
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_nsec += DATA_READY_TIMEOUT * 1000;
+	if (ts.tv_nsec >= 1000000000) {
+		ts.tv_sec += 1;
+		ts.tv_nsec -= 1000000000;
+	}
+
+	while (sem_timedwait(&dataReadySem, &ts) != 0) {
+		if (errno != EINTR) {
+			_ERROR("(%s-%d) wait for data ready timeout\n", __func__,
+					__LINE__);
+			return false;
+		}
+	}
+
+	while (sem_trywait(&dataReadySem) == 0) {
+		dataReadyClock.missedSamples++;
+	}
+
+	return true;
+}
+
+/**
+ * get period of data ready clock
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		period (us)
+ *
+ */
+static unsigned long dataReadyClockGetPeriod() {
+	return getMpu6050SamplePeriod();
+}
+#endif
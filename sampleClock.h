@@ -0,0 +1,46 @@
+/******************************************************************************
+The sampleClock.h in RaspberryPilot project is placed under the MIT license
+
+Copyright (c) 2016 jellyice1986 (Tung-Cheng Wu)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+******************************************************************************/
+
+#define CONTROL_CYCLE_TIME 500
+#define SAMPLE_CLOCK_JITTER_BUCKET_SIZE 50 // us
+#define SAMPLE_CLOCK_JITTER_BUCKET_NUM 40
+
+typedef struct {
+	char name[10]; //name of sample clock
+	bool (*init)(void); // set up the source of samples
+	bool (*waitForSample)(void); // block until next sample, return false if no sample arrived
+	unsigned long (*getPeriod)(void); // nominal interval between two samples (us)
+	unsigned long intervalHistogram[SAMPLE_CLOCK_JITTER_BUCKET_NUM]; // the last bucket also counts longer intervals
+	unsigned long missedSamples;
+	struct timeval last_tv; // time of the previous sample
+} SAMPLE_CLOCK_STRUCT;
+
+bool sampleClockInit();
+void setSampleClock(SAMPLE_CLOCK_STRUCT *clock);
+SAMPLE_CLOCK_STRUCT *getSampleClock();
+bool sampleClockFallBackToPolling();
+bool waitForNextSample();
+unsigned long getSamplePeriod();
+void printSampleClockJitterHistogram();
+void resetSampleClockJitterHistogram();
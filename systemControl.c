@@ -22,12 +22,15 @@
  SOFTWARE.
  ******************************************************************************/
 
+#define _GNU_SOURCE
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
 #include <signal.h>
+#include <sched.h>
 #include <pthread.h>
+#include <sys/mman.h>
 #include <wiringPi.h>
 #include "commonLib.h"
 #include "motorControl.h"
@@ -35,6 +38,8 @@
 #include "radioControl.h"
 #include "systemControl.h"
 
+#define PREFAULT_STACK_SIZE (512*1024)
+
 static bool flySystemIsEnableflag;
 static bool magnetCalibrationIsEnableflag;
 
@@ -70,6 +75,100 @@ bool piSystemInit() {
 	return true;
 }
 
+/**
+ * lock all current and future pages of the process in RAM and pre-fault the stack,
+ * so the real-time thread never waits on a page fault
+ *
+ * @param
+ *		void
+ *
+ * @return
+ *		bool
+ *
+ */
+bool lockProcessMemory() {
+
+	unsigned char dummy[PREFAULT_STACK_SIZE];
+
+	if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+		_ERROR("(%s-%d) mlockall failed\n", __func__, __LINE__);
+		return false;
+	}
+
+	memset(dummy, 0, sizeof(dummy));
+
+	return true;
+}
+
+/**
+ * change the scheduling policy of the calling thread to SCHED_FIFO
+ *
+ * @param priority
+ *		real-time priority (1-99)
+ *
+ * @return
+ *		bool
+ *
+ */
+bool setCurrentThreadRealTime(int priority) {
+
+	struct sched_param param;
+
+	memset(&param, 0, sizeof(param));
+	param.sched_priority = priority;
+
+	if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) != 0) {
+		_ERROR("(%s-%d) set SCHED_FIFO priority %d failed\n", __func__,
+				__LINE__, priority);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * pin the calling thread on a CPU core
+ *
+ * @param cpu
+ *		index of CPU core
+ *
+ * @return
+ *		bool
+ *
+ */
+bool setCurrentThreadAffinity(int cpu) {
+
+	cpu_set_t cpuset;
+
+	CPU_ZERO(&cpuset);
+	CPU_SET(cpu, &cpuset);
+
+	if (pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset)
+			!= 0) {
+		_ERROR("(%s-%d) pin thread on CPU %d failed\n", __func__, __LINE__,
+				cpu);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * keep a non real-time thread (radio, althold) away from the CPU core of the control thread
+ *
+ * @param
+ *		void
+ *
+ * @return
+ *		void
+ *
+ */
+void setupNonRealTimeThread() {
+#ifdef RT_CONTROL_THREAD
+	setCurrentThreadAffinity(RT_NON_RT_THREAD_CPU);
+#endif
+}
+
 /**
  * set piSystemIsEnable become true to indicate that RaspberryPilot CAN start flying
  *
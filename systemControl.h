@@ -23,6 +23,10 @@ SOFTWARE.
 ******************************************************************************/
 
 bool piSystemInit();
+bool lockProcessMemory();
+bool setCurrentThreadRealTime(int priority);
+bool setCurrentThreadAffinity(int cpu);
+void setupNonRealTimeThread();
 void enableFlySystem();
 void disenableFlySystem();
 bool flySystemIsEnable();
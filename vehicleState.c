@@ -0,0 +1,103 @@
+/******************************************************************************
+The vehicleState.c in RaspberryPilot project is placed under the MIT license
+
+Copyright (c) 2016 jellyice1986 (Tung-Cheng Wu)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include "commonLib.h"
+#include "pid.h"
+#include "flyControler.h"
+#include "motorControl.h"
+#include "attitudeUpdate.h"
+#include "altHold.h"
+#include "vehicleState.h"
+
+/**
+ * the snapshot is protected by a sequence lock:
+ * the control thread is the only writer, the sequence is odd while it is writing,
+ * readers retry if the sequence was odd or changed during the copy, so neither side blocks
+ */
+static VEHICLE_STATE_STRUCT vehicleState;
+static volatile unsigned long vehicleStateSeq = 0;
+
+/**
+ * publish the state of this control cycle, only the control thread calls this function
+ *
+ * @param
+ * 		void
+ *
+ * @return
+ *		void
+ *
+ */
+void publishVehicleState() {
+
+	__atomic_store_n(&vehicleStateSeq, vehicleStateSeq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	vehicleState.roll = getRoll();
+	vehicleState.pitch = getPitch();
+	vehicleState.yaw = getYaw();
+	vehicleState.rollGyro = getRollGyro();
+	vehicleState.pitchGyro = getPitchGyro();
+	vehicleState.yawGyro = getYawGyro();
+	vehicleState.verticalAcceleration = getVerticalAcceleration();
+	vehicleState.altitude = getCurrentAltHoldAltitude();
+	vehicleState.rollSp = getPidSp(&rollAttitudePidSettings);
+	vehicleState.pitchSp = getPidSp(&pitchAttitudePidSettings);
+	vehicleState.yawSp = getYawCenterPoint()
+			+ getPidSp(&yawAttitudePidSettings);
+	vehicleState.altitudeSp = getPidSp(&altHoldAltSettings);
+	vehicleState.throttle = getThrottlePowerLevel();
+	vehicleState.motorCCW1 = getMotorPowerLevelCCW1();
+	vehicleState.motorCW1 = getMotorPowerLevelCW1();
+	vehicleState.motorCCW2 = getMotorPowerLevelCCW2();
+	vehicleState.motorCW2 = getMotorPowerLevelCW2();
+	getMagnetCalibrationRawData(vehicleState.magCalRawData);
+	vehicleState.cycle++;
+
+	__atomic_store_n(&vehicleStateSeq, vehicleStateSeq + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * copy the latest published state without taking a lock
+ *
+ * @param state
+ * 		copy of state
+ *
+ * @return
+ *		void
+ *
+ */
+void getVehicleState(VEHICLE_STATE_STRUCT *state) {
+
+	unsigned long seq;
+
+	do {
+		seq = __atomic_load_n(&vehicleStateSeq, __ATOMIC_ACQUIRE);
+		memcpy(state, &vehicleState, sizeof(VEHICLE_STATE_STRUCT));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	} while ((seq & 1)
+			|| seq != __atomic_load_n(&vehicleStateSeq, __ATOMIC_RELAXED));
+}
@@ -0,0 +1,48 @@
+/******************************************************************************
+The vehicleState.h in RaspberryPilot project is placed under the MIT license
+
+Copyright (c) 2016 jellyice1986 (Tung-Cheng Wu)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+******************************************************************************/
+
+typedef struct {
+	float roll;
+	float pitch;
+	float yaw;
+	float rollGyro;
+	float pitchGyro;
+	float yawGyro;
+	float verticalAcceleration;
+	float altitude;
+	float rollSp;
+	float pitchSp;
+	float yawSp; // yaw center point + yaw shift
+	float altitudeSp;
+	unsigned short throttle;
+	unsigned short motorCCW1;
+	unsigned short motorCW1;
+	unsigned short motorCCW2;
+	unsigned short motorCW2;
+	short magCalRawData[9];
+	unsigned long cycle; // number of published snapshots
+} VEHICLE_STATE_STRUCT;
+
+void publishVehicleState();
+void getVehicleState(VEHICLE_STATE_STRUCT *state);